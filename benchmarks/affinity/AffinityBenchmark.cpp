@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchmarkEndpoint.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Ping-pong round trips between one client and the server, first with both I/O threads left
+// to the scheduler, then with each one pinned to a CPU of its own (the same one on a single
+// CPU machine). The next ping is sent from the client's callback as soon as the echo arrives.
+//
+constexpr size_t kRoundTrips = 20000;
+constexpr size_t kWarmUp = 1000;
+constexpr size_t kPingSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+void Print(const std::string& title, std::vector<long long>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) {
+        return samples.empty() ? 0 : samples[static_cast<size_t>(p * (samples.size() - 1))];
+    };
+
+    std::cout << title << ": " << samples.size() << " round trips, p50 " << percentile(0.5)
+              << " ns, p99 " << percentile(0.99) << " ns, p99.9 " << percentile(0.999)
+              << " ns, max " << percentile(1.0) << " ns\n";
+}
+
+bool Run(const Endpoint& endpoint, bool pinned, const std::string& title)
+{
+    ServerConfig server_config;
+    server_config.framing.enabled = true;
+    server_config.socket_options.tcp_nodelay = true;
+
+    ClientConfig client_config;
+    client_config.framing.enabled = true;
+    client_config.socket_options.tcp_nodelay = true;
+
+    if (pinned)
+    {
+        int cpus = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U));
+
+        server_config.io_threads.cpus = {0};
+        server_config.io_threads.numa_local_buffers = true;
+        client_config.io_thread.cpus = {cpus > 1 ? 1 : 0};
+        client_config.io_thread.numa_local_buffers = true;
+    }
+
+    auto server = CreateServer(endpoint, server_config);
+    if (!server) return false;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    bool disconnected = false;
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr, bool is_connected) {
+            std::lock_guard<std::mutex> lk(m);
+            disconnected = !is_connected;
+            cv.notify_one();
+        },
+        [](IClientHandlerPtr client, DataView data) { client->Send({data}); });
+    if (!started) return false;
+
+    std::vector<long long> samples;
+    samples.reserve(kRoundTrips);
+
+    size_t round_trips = 0;
+
+    std::vector<uint8_t> ping(kPingSize);
+    IClient* raw_client = nullptr;
+
+    auto send_ping = [&]() {
+        Clock::rep now = Clock::now().time_since_epoch().count();
+
+        std::memcpy(ping.data(), &now, sizeof(now));
+        raw_client->Send(ping);
+    };
+
+    auto client = CreateClient(endpoint, client_config);
+    if (!client) return false;
+    raw_client = client.get();
+
+    bool connected = client->Connect([]() {}, [&](DataView data) {
+        Clock::rep sent;
+        std::memcpy(&sent, data.data(), sizeof(sent));
+
+        auto rtt = Clock::now() - Clock::time_point(Clock::duration(sent));
+
+        if (++round_trips > kWarmUp)
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(rtt).count());
+
+        if (round_trips < kWarmUp + kRoundTrips)
+        {
+            send_ping();
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(m);
+            done = true;
+            cv.notify_one();
+        }
+    });
+    if (!connected) return false;
+
+    send_ping();
+
+    {
+        std::unique_lock<std::mutex> lk(m);
+        if (!cv.wait_for(lk, 60s, [&]() { return done; })) return false;
+    }
+
+    client.reset();
+
+    //
+    // The server closes its end after the client, so it is not the one left in TIME_WAIT
+    // and the next run can listen on the same port
+    //
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv.wait_for(lk, 1s, [&]() { return disconnected; });
+    }
+
+    server->Stop();
+
+    Print(title, samples);
+
+    return true;
+}
+
+int main(int argc, char const* argv[])
+{
+    Endpoint endpoint;
+
+    if (!ParseEndpoint(argc, argv, endpoint)) return EXIT_FAILURE;
+
+    if (!Run(endpoint, false, "Unpinned") || !Run(endpoint, true, "Pinned  "))
+    {
+        std::cout << "ERROR: benchmark setup failed!\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
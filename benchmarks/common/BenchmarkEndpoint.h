@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Where the benchmarks connect, taken from the command line:
+// <unix socket path> or <inet address> <inet port>
+//
+struct Endpoint
+{
+    const char* socket_path = nullptr;
+    const char* inet_address = nullptr;
+    int inet_port = 0;
+};
+
+// Prints the usage and returns false on wrong arguments
+inline bool ParseEndpoint(int argc, char const* argv[], Endpoint& endpoint)
+{
+    if (argc == 2)
+    {
+        endpoint.socket_path = argv[1];
+    }
+    else if (argc == 3)
+    {
+        endpoint.inet_address = argv[1];
+        endpoint.inet_port = atoi(argv[2]);
+    }
+    else
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: <unix socket path>\n";
+        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        return false;
+    }
+
+    return true;
+}
+
+inline IServerPtr CreateServer(const Endpoint& endpoint, const ServerConfig& config)
+{
+    if (endpoint.socket_path) return CreateUnixServer(endpoint.socket_path, config);
+
+    return CreateInetServer(endpoint.inet_address, endpoint.inet_port, config);
+}
+
+inline IClientPtr CreateClient(const Endpoint& endpoint, const ClientConfig& config)
+{
+    if (endpoint.socket_path) return CreateUnixClient(endpoint.socket_path, config);
+
+    return CreateInetClient(endpoint.inet_address, endpoint.inet_port, config);
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/StaticClient.h"
+#include "libsercli/StaticServer.h"
+
+#include "BenchmarkEndpoint.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Receive path cost per message: a few clients flood the server with small framed messages and
+// the time until it has taken them all is measured, for IServer with the std::function
+// callbacks, IServer with an IServerHandler and the header-only StaticServer. The server only
+// counts the messages, so what is left is the reading, the framing and the dispatch.
+// Then the same for the client side: a server floods one IClient, then one StaticClient.
+//
+constexpr size_t kClients = 4;
+constexpr size_t kMessagesPerClient = 500000;
+constexpr size_t kMessageSize = 16;
+constexpr size_t kChunkSize = 64 * 1024; // read by the server at once
+constexpr auto kTimeout = 60s;
+
+using Clock = std::chrono::steady_clock;
+
+// Plain blocking socket, so the clients cost the same with every server
+int Connect(const Endpoint& endpoint)
+{
+    int sock = -1;
+
+    if (endpoint.socket_path)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, endpoint.socket_path, sizeof(addr.sun_path) - 1);
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock != -1 && connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+            return sock;
+    }
+    else
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(endpoint.inet_address);
+        addr.sin_port = htons(static_cast<uint16_t>(endpoint.inet_port));
+
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock != -1 && connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+            return sock;
+    }
+
+    if (sock != -1) close(sock);
+    return -1;
+}
+
+// Plain listening socket, so the server costs the same with every client
+int Listen(const Endpoint& endpoint)
+{
+    int sock = -1;
+    int reuse = 1;
+
+    if (endpoint.socket_path)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, endpoint.socket_path, sizeof(addr.sun_path) - 1);
+
+        unlink(endpoint.socket_path);
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock != -1 && bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+            listen(sock, 1) == 0)
+            return sock;
+    }
+    else
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(endpoint.inet_address);
+        addr.sin_port = htons(static_cast<uint16_t>(endpoint.inet_port));
+
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock != -1 && setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+            bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+            listen(sock, 1) == 0)
+            return sock;
+    }
+
+    if (sock != -1) close(sock);
+    return -1;
+}
+
+void CloseListener(const Endpoint& endpoint, int sock)
+{
+    close(sock);
+    if (endpoint.socket_path) unlink(endpoint.socket_path);
+}
+
+//
+// What the server does with a message: counts it and tells when all have come
+//
+class Counter
+{
+public:
+    explicit Counter(size_t target)
+        : target_{target}
+        , messages_{0}
+    {
+    }
+
+    void Add(DataView data)
+    {
+        if (data.size() != kMessageSize) return;
+
+        if (++messages_ == target_) done_.set_value();
+    }
+
+    bool Wait() { return done_.get_future().wait_for(kTimeout) == std::future_status::ready; }
+
+private:
+    const size_t target_;
+    size_t messages_; // by the I/O thread only
+    std::promise<void> done_;
+};
+
+class CountingHandler : public IServerHandler
+{
+public:
+    explicit CountingHandler(Counter& counter)
+        : counter_{counter}
+    {
+    }
+
+    void OnClientStatus(IClientHandler&, bool) override {}
+    void OnDataReceived(IClientHandler&, const Buffer& data) override { counter_.Add(data.View()); }
+
+private:
+    Counter& counter_;
+};
+
+class StaticCountingHandler
+{
+public:
+    explicit StaticCountingHandler(Counter& counter)
+        : counter_{counter}
+    {
+    }
+
+    template <class Connection>
+    void OnClientStatus(Connection&, bool)
+    {
+    }
+
+    template <class Connection>
+    void OnDataReceived(Connection&, DataView data)
+    {
+        counter_.Add(data);
+    }
+
+private:
+    Counter& counter_;
+};
+
+// Whole frames with the 4 byte big-endian length, a chunk of the reader's size
+std::vector<uint8_t> MakeBlock()
+{
+    std::vector<uint8_t> block;
+
+    for (size_t i = 0; i < kChunkSize / (4 + kMessageSize); ++i)
+    {
+        uint8_t header[4] = {0, 0, 0, kMessageSize};
+        block.insert(block.end(), header, header + sizeof(header));
+        block.insert(block.end(), kMessageSize, 'M');
+    }
+
+    return block;
+}
+
+void WriteMessages(int sock, const std::vector<uint8_t>& block, size_t messages)
+{
+    const size_t frames_per_block = block.size() / (4 + kMessageSize);
+
+    for (size_t sent = 0; sent < messages;)
+    {
+        size_t frames = std::min(frames_per_block, messages - sent);
+        size_t size = frames * (4 + kMessageSize);
+
+        for (size_t pos = 0; pos < size;)
+        {
+            ssize_t written = write(sock, block.data() + pos, size - pos);
+            if (written <= 0) return;
+            pos += static_cast<size_t>(written);
+        }
+
+        sent += frames;
+    }
+}
+
+// Floods the server and waits until the counter has all, the elapsed time or 0 on failure
+Clock::duration Flood(const Endpoint& endpoint, Counter& counter)
+{
+    std::vector<int> sockets;
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        int sock = Connect(endpoint);
+        if (sock == -1) break;
+        sockets.push_back(sock);
+    }
+
+    const std::vector<uint8_t> block = MakeBlock();
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+
+    for (int sock : sockets)
+        threads.emplace_back([&, sock]() { WriteMessages(sock, block, kMessagesPerClient); });
+
+    bool ok = sockets.size() == kClients && counter.Wait();
+    auto elapsed = Clock::now() - start;
+
+    for (auto& thread : threads) thread.join();
+    // Clients close first, the server's port is free again right away
+    for (int sock : sockets) close(sock);
+
+    return ok ? elapsed : Clock::duration::zero();
+}
+
+//
+// Floods the client connected to the listener with the messages of all clients above and waits
+// until the counter has all, the elapsed time or 0 on failure. The connection is left open,
+// for the client to close first.
+//
+Clock::duration FloodClient(int listener, Counter& counter, int* sock)
+{
+    *sock = accept(listener, nullptr, nullptr);
+    if (*sock == -1) return Clock::duration::zero();
+
+    const std::vector<uint8_t> block = MakeBlock();
+
+    auto start = Clock::now();
+    std::thread writer([&]() { WriteMessages(*sock, block, kClients * kMessagesPerClient); });
+
+    bool ok = counter.Wait();
+    auto elapsed = Clock::now() - start;
+
+    writer.join();
+
+    return ok ? elapsed : Clock::duration::zero();
+}
+
+void Print(const std::string& title, Clock::duration elapsed)
+{
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    double messages = static_cast<double>(kClients * kMessagesPerClient);
+
+    std::cout << title << ": " << static_cast<long long>(messages * 1e6 / ns)
+              << "k messages/s, " << ns / messages << " ns per message\n";
+}
+
+bool RunLibrary(const Endpoint& endpoint, bool with_handler)
+{
+    ServerConfig config;
+    config.framing.enabled = true;
+    config.socket_options.receive_chunk_size = kChunkSize;
+    config.read_budget.max_bytes = 0;
+    config.read_budget.max_messages = 0;
+
+    auto server = CreateServer(endpoint, config);
+    if (!server) return false;
+
+    Counter counter(kClients * kMessagesPerClient);
+    CountingHandler handler(counter);
+
+    bool started = with_handler
+                       ? server->Start(handler)
+                       : server->Start(
+                             [](IClientHandlerPtr, bool) {},
+                             [&](IClientHandlerPtr, const Buffer& data) {
+                                 counter.Add(data.View());
+                             });
+    if (!started) return false;
+
+    auto elapsed = Flood(endpoint, counter);
+    server->Stop();
+
+    if (elapsed == Clock::duration::zero()) return false;
+
+    Print(with_handler ? "IServer, IServerHandler " : "IServer, callbacks      ", elapsed);
+    return true;
+}
+
+template <class Transport>
+bool RunStatic(const Endpoint& endpoint, Transport transport)
+{
+    Counter counter(kClients * kMessagesPerClient);
+    StaticCountingHandler handler(counter);
+
+    StaticServer<Transport, LengthFraming, StaticCountingHandler> server(
+        std::move(transport), handler, LengthFraming(), std::allocator<uint8_t>(), kChunkSize);
+    if (!server.Start()) return false;
+
+    auto elapsed = Flood(endpoint, counter);
+    server.Stop();
+
+    if (elapsed == Clock::duration::zero()) return false;
+
+    Print("StaticServer            ", elapsed);
+    return true;
+}
+
+class StaticClientCountingHandler
+{
+public:
+    explicit StaticClientCountingHandler(Counter& counter)
+        : counter_{counter}
+    {
+    }
+
+    template <class Client>
+    void OnDisconnected(Client&)
+    {
+    }
+
+    template <class Client>
+    void OnDataReceived(Client&, DataView data)
+    {
+        counter_.Add(data);
+    }
+
+private:
+    Counter& counter_;
+};
+
+bool RunLibraryClient(const Endpoint& endpoint)
+{
+    int listener = Listen(endpoint);
+    if (listener == -1) return false;
+
+    ClientConfig config;
+    config.framing.enabled = true;
+    config.socket_options.receive_chunk_size = kChunkSize;
+
+    Counter counter(kClients * kMessagesPerClient);
+    auto client = CreateClient(endpoint, config);
+
+    bool connected = client && client->Connect(
+                                   []() {}, [&](const Buffer& data) { counter.Add(data.View()); });
+
+    int sock = -1;
+    auto elapsed = connected ? FloodClient(listener, counter, &sock) : Clock::duration::zero();
+
+    if (client) client->Disconnect();
+    if (sock != -1) close(sock);
+    CloseListener(endpoint, listener);
+
+    if (elapsed == Clock::duration::zero()) return false;
+
+    Print("IClient, callbacks      ", elapsed);
+    return true;
+}
+
+template <class Transport>
+bool RunStaticClient(const Endpoint& endpoint, Transport transport)
+{
+    int listener = Listen(endpoint);
+    if (listener == -1) return false;
+
+    Counter counter(kClients * kMessagesPerClient);
+    StaticClientCountingHandler handler(counter);
+
+    StaticClient<Transport, LengthFraming, StaticClientCountingHandler> client(
+        std::move(transport), handler, LengthFraming(), std::allocator<uint8_t>(), kChunkSize);
+
+    int sock = -1;
+    auto elapsed = client.Connect() ? FloodClient(listener, counter, &sock)
+                                    : Clock::duration::zero();
+
+    client.Disconnect();
+    if (sock != -1) close(sock);
+    CloseListener(endpoint, listener);
+
+    if (elapsed == Clock::duration::zero()) return false;
+
+    Print("StaticClient            ", elapsed);
+    return true;
+}
+
+int main(int argc, char const* argv[])
+{
+    Endpoint endpoint;
+
+    if (!ParseEndpoint(argc, argv, endpoint)) return EXIT_FAILURE;
+
+    bool ok = RunLibrary(endpoint, false) && RunLibrary(endpoint, true) &&
+              (endpoint.socket_path
+                   ? RunStatic(endpoint, UnixTransport(endpoint.socket_path))
+                   : RunStatic(
+                         endpoint, InetTransport(endpoint.inet_address, endpoint.inet_port))) &&
+              RunLibraryClient(endpoint) &&
+              (endpoint.socket_path
+                   ? RunStaticClient(endpoint, UnixTransport(endpoint.socket_path))
+                   : RunStaticClient(
+                         endpoint, InetTransport(endpoint.inet_address, endpoint.inet_port)));
+
+    if (!ok)
+    {
+        std::cout << "ERROR: benchmark setup failed!\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchmarkEndpoint.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Round-trip latency of light clients pinging a single-threaded server while one more client
+// floods it, measured without a read budget and with the default one. Without a budget the
+// server drains the flooding client's socket before it gets to the pings.
+//
+constexpr size_t kLightClients = 8;
+constexpr auto kPingInterval = 1ms;
+constexpr auto kRunTime = 2s;
+constexpr size_t kFloodFrameSize = 64 * 1024;
+constexpr uint8_t kPing = 'P';
+constexpr uint8_t kFlood = 'F';
+
+using Clock = std::chrono::steady_clock;
+
+class Latencies
+{
+public:
+    void Add(Clock::duration rtt)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        samples_.push_back(std::chrono::duration_cast<std::chrono::microseconds>(rtt).count());
+    }
+
+    void Print(const std::string& title)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+
+        std::sort(samples_.begin(), samples_.end());
+
+        auto percentile = [&](double p) {
+            return samples_.empty() ? 0 : samples_[static_cast<size_t>(p * (samples_.size() - 1))];
+        };
+
+        std::cout << title << ": " << samples_.size() << " pings, p50 " << percentile(0.5)
+                  << " us, p99 " << percentile(0.99) << " us, max " << percentile(1.0)
+                  << " us\n";
+    }
+
+private:
+    std::mutex m_;
+    std::vector<long long> samples_;
+};
+
+bool Run(const Endpoint& endpoint, const ReadBudgetConfig& read_budget, const std::string& title)
+{
+    ServerConfig server_config;
+    server_config.framing.enabled = true;
+    server_config.read_budget = read_budget;
+
+    ClientConfig client_config;
+    client_config.framing.enabled = true;
+
+    auto server = CreateServer(endpoint, server_config);
+    if (!server) return false;
+
+    std::atomic_size_t connected{0};
+    std::atomic_size_t flooded{0};
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr, bool is_connected) {
+            if (is_connected) ++connected;
+        },
+        [&](IClientHandlerPtr client, DataView data) {
+            // Pings are echoed, the flood is only counted
+            if (!data.empty() && data.data()[0] == kPing)
+                client->Send({data});
+            else
+                flooded += data.size();
+        });
+    if (!started) return false;
+
+    Latencies latencies;
+    std::vector<IClientPtr> light_clients;
+
+    for (size_t i = 0; i < kLightClients; ++i)
+    {
+        auto client = CreateClient(endpoint, client_config);
+
+        bool ok = client && client->Connect([]() {}, [&](DataView data) {
+            Clock::rep sent;
+            std::memcpy(&sent, data.data() + 1, sizeof(sent));
+            latencies.Add(Clock::now() - Clock::time_point(Clock::duration(sent)));
+        });
+        if (!ok) return false;
+
+        light_clients.emplace_back(std::move(client));
+    }
+
+    // Sends are paced by the watermarks, so the flood is as fast as the server reads
+    client_config.send_watermarks.high = 4 * 1024 * 1024;
+    client_config.send_watermarks.low = 1024 * 1024;
+
+    auto flood_client = CreateClient(endpoint, client_config);
+    if (!flood_client || !flood_client->Connect([]() {}, [](DataView) {})) return false;
+
+    while (connected < kLightClients + 1) std::this_thread::sleep_for(1ms);
+
+    std::atomic_bool running{true};
+
+    std::thread flood_thread([&]() {
+        std::vector<uint8_t> frame(kFloodFrameSize, kFlood);
+
+        while (running)
+        {
+            if (flood_client->IsWritable())
+                flood_client->Send(frame);
+            else
+                std::this_thread::sleep_for(100us);
+        }
+    });
+
+    auto end = Clock::now() + kRunTime;
+
+    while (Clock::now() < end)
+    {
+        for (auto& client : light_clients)
+        {
+            uint8_t ping[1 + sizeof(Clock::rep)] = {kPing};
+            Clock::rep now = Clock::now().time_since_epoch().count();
+
+            std::memcpy(ping + 1, &now, sizeof(now));
+            client->Send({DataView(ping, sizeof(ping))});
+        }
+
+        std::this_thread::sleep_for(kPingInterval);
+    }
+
+    running = false;
+    flood_thread.join();
+
+    // Late echoes are not waited for, the tail already shows
+    latencies.Print(title);
+    std::cout << "    flood: " << flooded / (1024 * 1024) << " MB received by the server\n";
+
+    flood_client.reset();
+    light_clients.clear();
+    server->Stop();
+
+    return true;
+}
+
+int main(int argc, char const* argv[])
+{
+    Endpoint endpoint;
+
+    if (!ParseEndpoint(argc, argv, endpoint)) return EXIT_FAILURE;
+
+    ReadBudgetConfig unlimited;
+    unlimited.max_bytes = 0;
+    unlimited.max_messages = 0;
+
+    if (!Run(endpoint, unlimited, "No read budget     ") ||
+        !Run(endpoint, ReadBudgetConfig(), "Default read budget"))
+    {
+        std::cout << "ERROR: benchmark setup failed!\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// How many connections the server takes on
+//
+struct AdmissionConfig
+{
+    //
+    // Connections the kernel keeps waiting to be accepted, 0 for the system maximum (SOMAXCONN)
+    //
+    int backlog = 0;
+    //
+    // Clients served at once, 0 for no limit (Linux only). At the limit the server stops
+    // accepting, connections over it wait in the listen backlog until a client leaves.
+    //
+    size_t max_connections = 0;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
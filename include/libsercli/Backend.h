@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+#define DLL_EXPORT
+#else
+#define DLL_EXPORT __declspec(dllexport)
+#endif
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// I/O mechanism of the Linux implementation, ignored on Windows
+//
+enum class Backend
+{
+    //
+    // epoll reactors with read() and sendmsg() calls
+    //
+    kEpoll,
+    //
+    // io_uring rings with multishot accept, multishot recv into a provided buffer ring and sends
+    // submitted in batches, needs Linux 6.0 or newer: Start()/Connect() fail without it.
+    // Sends are always copied and batched, so write_coalescing and zero_copy_min_bytes
+    // don't apply.
+    //
+    kIoUring,
+};
+
+// Whether servers and clients can run on backend here, kIoUring is never supported on Windows
+bool DLL_EXPORT IsBackendSupported(Backend backend);
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#undef DLL_EXPORT
\ No newline at end of file
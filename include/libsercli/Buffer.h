@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "libsercli/DataView.h"
+
+#ifdef __linux__
+#define DLL_EXPORT
+#else
+#define DLL_EXPORT __declspec(dllexport)
+#endif
+
+namespace nkhlab {
+namespace libsercli {
+
+struct BufferBlock;
+
+//
+// Reference to a fixed-size, reference-counted buffer from a receive buffer pool,
+// or to a part of one. Copies share the same memory without copying it, the buffer goes back
+// to its pool when the last reference is dropped. Safe to copy and release from any thread.
+//
+class DLL_EXPORT Buffer
+{
+public:
+    Buffer();
+    ~Buffer();
+
+    Buffer(const Buffer& other);
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(const Buffer& other);
+    Buffer& operator=(Buffer&& other) noexcept;
+
+    const uint8_t* data() const;
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    const uint8_t* begin() const { return data(); }
+    const uint8_t* end() const { return data() + size(); }
+
+    DataView View() const { return DataView(data(), size()); }
+
+    size_t UseCount() const;
+    void Reset();
+
+    explicit operator bool() const { return block_ != nullptr; }
+
+private:
+    explicit Buffer(BufferBlock* block);
+
+    BufferBlock* block_;
+    size_t offset_;
+    size_t size_;
+
+    friend class BufferPool;
+};
+
+struct BufferPoolConfig
+{
+    //
+    // Number of buffers allocated upfront, each one is of the receive chunk size.
+    // When all of them are retained by callbacks, further buffers come from the heap.
+    //
+    size_t buffer_count = 64;
+    //
+    // Back the pool with huge pages (Linux only), falls back to transparent huge pages
+    // and then to regular pages when none are reserved in the system
+    //
+    bool huge_pages = false;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#undef DLL_EXPORT
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <chrono>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Opt-in spinning of the I/O threads for links where the wakeup from a blocking wait costs too
+// much (Linux only). Before it goes to sleep, a thread keeps asking the kernel for new events
+// without blocking until spin_time has passed, a whole CPU core is busy meanwhile.
+// Kernel busy polling of the device queues comes on top with SocketOptions::busy_poll_us.
+//
+struct BusyPollConfig
+{
+    //
+    // Longest a thread polls for events before it blocks, 0 disables spinning
+    //
+    std::chrono::microseconds spin_time{0};
+};
+
+} // namespace libsercli
+} // namespace nkhlab
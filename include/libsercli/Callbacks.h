@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <functional>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Reports the result of a Send() that returned true: sent is true once all the data has been
+// handed over to the system, false if the connection was closed before that
+//
+using SendCompletedCb = std::function<void(bool sent)>;
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -13,7 +13,9 @@
 
 #include <memory>
 
+#include "libsercli/ClientConfig.h"
 #include "libsercli/IClient.h"
+#include "libsercli/IClientEventLoop.h"
 
 #ifdef __linux__
 #define DLL_EXPORT
@@ -26,8 +28,20 @@ namespace libsercli {
 
 using IClientPtr = std::unique_ptr<IClient>;
 
-IClientPtr DLL_EXPORT CreateUnixClient(const char* socket_path);
-IClientPtr DLL_EXPORT CreateInetClient(const char* address, int port);
+IClientPtr DLL_EXPORT
+CreateUnixClient(const char* socket_path, const ClientConfig& config = ClientConfig());
+IClientPtr DLL_EXPORT
+CreateInetClient(const char* address, int port, const ClientConfig& config = ClientConfig());
+
+//
+// Threads to share among clients through ClientConfig::event_loop, nullptr on failure
+// or on Windows. max_events: events each thread takes from the kernel per wakeup,
+// thread_config: names and CPUs of the threads.
+//
+IClientEventLoopPtr DLL_EXPORT CreateClientEventLoop(
+    size_t threads = 1,
+    size_t max_events = ReadBudgetConfig().max_events,
+    const ThreadConfig& thread_config = ThreadConfig());
 
 } // namespace libsercli
 } // namespace nkhlab
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "libsercli/Backend.h"
+#include "libsercli/Buffer.h"
+#include "libsercli/BusyPollConfig.h"
+#include "libsercli/FramingConfig.h"
+#include "libsercli/IClientEventLoop.h"
+#include "libsercli/MemoryResource.h"
+#include "libsercli/ReadBudgetConfig.h"
+#include "libsercli/SocketOptions.h"
+#include "libsercli/ThreadConfig.h"
+#include "libsercli/WatermarkConfig.h"
+#include "libsercli/WriteCoalescingConfig.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+struct ClientConfig
+{
+    //
+    // Pool received data lands in
+    //
+    BufferPoolConfig receive_pool;
+    //
+    // Batching of small sends
+    //
+    WriteCoalescingConfig write_coalescing;
+    //
+    // Payloads of at least this many bytes sent with SendZeroCopy() are not copied into the
+    // kernel (Linux Inet connections only), 0 disables zero-copy
+    //
+    size_t zero_copy_min_bytes = 0;
+    //
+    // I/O mechanism, the same interface on top of either
+    //
+    Backend backend = Backend::kEpoll;
+    //
+    // Length-prefixed messages instead of a plain byte stream
+    //
+    FramingConfig framing;
+    //
+    // When the connection is reported unwritable and writable again
+    //
+    WatermarkConfig send_watermarks;
+    //
+    // Share of each event loop iteration for this client, max_events applies to a thread of
+    // its own only, a shared event loop takes it from CreateClientEventLoop()
+    //
+    ReadBudgetConfig read_budget;
+    //
+    // Shared I/O threads to run on (epoll backend only), a thread of its own when empty
+    //
+    IClientEventLoopPtr event_loop;
+    //
+    // Socket level tuning and the size of the receive buffers
+    //
+    SocketOptions socket_options;
+    //
+    // Name and CPU of the I/O thread of its own, a shared event loop takes them from
+    // CreateClientEventLoop()
+    //
+    ThreadConfig io_thread;
+    //
+    // Spinning of the I/O thread of its own before it blocks, not applied to a shared event loop
+    //
+    BusyPollConfig busy_poll;
+    //
+    // Per message allocations, nullptr for the global heap.
+    // Not owned, is to outlive the client, see MemoryResource.
+    //
+    MemoryResource* memory_resource = nullptr;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Non-owning pointer and length of a byte buffer
+//
+class DataView
+{
+public:
+    DataView()
+        : data_{nullptr}
+        , size_{0}
+    {
+    }
+
+    DataView(const uint8_t* data, size_t size)
+        : data_{data}
+        , size_{size}
+    {
+    }
+
+    explicit DataView(const std::vector<uint8_t>& data)
+        : data_{data.data()}
+        , size_{data.size()}
+    {
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Opt-in thread pool the server runs its received data callbacks on, so a slow callback doesn't
+// hold up the I/O of other clients. Callbacks of one client run one after another in the order
+// the data arrived, those of different clients run in parallel. The disconnected status
+// callback of a client comes after its last data callback.
+//
+struct ExecutorConfig
+{
+    //
+    // Pool threads, 0 runs the callbacks on the I/O threads
+    //
+    size_t threads = 0;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Callbacks run by the server's thread pool since it was started, see ExecutorConfig.
+// Queueing delay is the time from the data being read to its callback being called.
+//
+struct ExecutorStats
+{
+    uint64_t callbacks = 0;
+    std::chrono::nanoseconds total_queue_delay{0};
+    std::chrono::nanoseconds max_queue_delay{0};
+};
+
+} // namespace libsercli
+} // namespace nkhlab
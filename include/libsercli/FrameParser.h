@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Framing on the wire, see FramingConfig: a 4 byte big-endian length in front of every message.
+// Shared by IServer/IClient and the header-only StaticServer/StaticClient.
+//
+
+constexpr size_t kFrameHeaderSize = 4;
+
+// false when size is over the limit
+inline bool EncodeFrameHeader(size_t size, size_t max_frame_size, uint8_t* header)
+{
+    if (size > max_frame_size || size > std::numeric_limits<uint32_t>::max()) return false;
+
+    header[0] = static_cast<uint8_t>(size >> 24);
+    header[1] = static_cast<uint8_t>(size >> 16);
+    header[2] = static_cast<uint8_t>(size >> 8);
+    header[3] = static_cast<uint8_t>(size);
+    return true;
+}
+
+//
+// Follows the frames of one connection across received chunks. A frame that lies in one chunk is
+// reported by its place in it, only frames spread over several chunks are copied together into
+// the Reassembly, a class with
+//     void Begin(size_t frame_size);                 // a frame of this size starts
+//     void Append(const uint8_t* data, size_t size); // more of it, up to the frame size in total
+//
+template <class Reassembly>
+class FrameParser
+{
+public:
+    FrameParser(size_t max_frame_size, Reassembly reassembly)
+        : reassembly_{std::move(reassembly)}
+        , max_frame_size_{max_frame_size}
+        , header_size_{0}
+        , frame_size_{0}
+        , frame_filled_{0}
+        , reassembling_{false}
+    {
+    }
+
+    //
+    // in_chunk_cb(size_t pos, size_t size) gets a frame that lies whole in the chunk,
+    // reassembled_cb(Reassembly& reassembly) one completed from several. Either returns false to
+    // stop after its frame, consumed tells how far the chunk was taken then, all of it otherwise.
+    // Returns false when a frame over the limit comes in, the stream can't be followed then.
+    //
+    template <class InChunkCb, class ReassembledCb>
+    bool Feed(
+        const uint8_t* data,
+        size_t size,
+        InChunkCb&& in_chunk_cb,
+        ReassembledCb&& reassembled_cb,
+        size_t* consumed);
+
+private:
+    Reassembly reassembly_;
+    const size_t max_frame_size_;
+
+    uint8_t header_[kFrameHeaderSize];
+    size_t header_size_;
+    size_t frame_size_;
+    size_t frame_filled_;
+    bool reassembling_;
+};
+
+template <class Reassembly>
+template <class InChunkCb, class ReassembledCb>
+bool FrameParser<Reassembly>::Feed(
+    const uint8_t* data,
+    size_t size,
+    InChunkCb&& in_chunk_cb,
+    ReassembledCb&& reassembled_cb,
+    size_t* consumed)
+{
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        if (reassembling_)
+        {
+            // Rest of a frame that started in an earlier chunk
+            size_t len = std::min(size - pos, frame_size_ - frame_filled_);
+
+            reassembly_.Append(data + pos, len);
+            frame_filled_ += len;
+            pos += len;
+
+            if (frame_filled_ == frame_size_)
+            {
+                reassembling_ = false;
+
+                if (!reassembled_cb(reassembly_)) break;
+            }
+            continue;
+        }
+
+        size_t len = std::min(size - pos, kFrameHeaderSize - header_size_);
+
+        memcpy(header_ + header_size_, data + pos, len);
+        header_size_ += len;
+        pos += len;
+
+        if (header_size_ < kFrameHeaderSize) break;
+
+        header_size_ = 0;
+        frame_size_ = (size_t(header_[0]) << 24) | (size_t(header_[1]) << 16) |
+                      (size_t(header_[2]) << 8) | size_t(header_[3]);
+
+        if (frame_size_ > max_frame_size_) return false;
+
+        if (size - pos >= frame_size_)
+        {
+            // Whole frame in this chunk, no copy
+            pos += frame_size_;
+
+            if (!in_chunk_cb(pos - frame_size_, frame_size_)) break;
+        }
+        else
+        {
+            reassembly_.Begin(frame_size_);
+            frame_filled_ = 0;
+            reassembling_ = true;
+        }
+    }
+
+    *consumed = pos;
+    return true;
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Opt-in message framing: every message goes with a 4 byte big-endian length in front of it.
+// The received data callbacks get whole messages instead of stream chunks, a message that
+// arrives in one chunk is handed out without a copy. Both sides have to enable it.
+//
+struct FramingConfig
+{
+    bool enabled = false;
+    //
+    // Larger messages are refused by Send(), receiving one closes the connection
+    //
+    size_t max_frame_size = 1024 * 1024;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
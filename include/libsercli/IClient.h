@@ -12,9 +12,15 @@
 #pragma once
 
 #include <functional>
+#include <initializer_list>
 #include <string>
 #include <vector>
 
+#include "libsercli/Buffer.h"
+#include "libsercli/Callbacks.h"
+#include "libsercli/DataView.h"
+#include "libsercli/PollStats.h"
+
 #ifdef __linux__
 #define DLL_EXPORT
 #else
@@ -26,6 +32,20 @@ namespace libsercli {
 
 using ServerDisconnectedCb = std::function<void()>;
 using ClientDataReceivedCb = std::function<void(const std::vector<uint8_t>& data)>;
+//
+// Zero-copy variant: data points into a receive buffer reused by the library,
+// it is valid only until the callback returns
+//
+using ClientDataViewReceivedCb = std::function<void(DataView data)>;
+//
+// Pooled variant: data may be kept after the callback returns by copying the Buffer,
+// which shares the same memory
+//
+using ClientBufferReceivedCb = std::function<void(const Buffer& data)>;
+//
+// Reports crossing the send watermarks, from the thread that made the queue grow or shrink
+//
+using WritableCb = std::function<void(bool writable)>;
 
 class DLL_EXPORT IClient
 {
@@ -35,9 +55,84 @@ public:
     virtual bool Connect(
         ServerDisconnectedCb server_disconnected_cb,
         ClientDataReceivedCb data_received_cb) = 0;
+    virtual bool Connect(
+        ServerDisconnectedCb server_disconnected_cb,
+        ClientDataViewReceivedCb data_received_cb) = 0;
+    virtual bool Connect(
+        ServerDisconnectedCb server_disconnected_cb,
+        ClientBufferReceivedCb data_received_cb) = 0;
+    //
+    // No callback is made once it returns, except the one it is called from (Linux).
+    // The client itself must not be destroyed from its callbacks.
+    //
     virtual void Disconnect() = 0;
 
+    // To be set before Connect()
+    virtual void SetWritableCb(WritableCb writable_cb) = 0;
+
+    //
+    // Non-blocking and thread safe: data is written at once when possible, the rest is queued
+    // and written by the client in the background. Returns false if not connected.
+    //
     virtual bool Send(const std::vector<uint8_t>& data) = 0;
+    virtual bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) = 0;
+
+    //
+    // Scatter-gather: the buffers go out back to back in a single system call,
+    // e.g. Send({DataView(header), DataView(body)})
+    //
+    virtual bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) = 0;
+
+    bool Send(std::initializer_list<DataView> data, SendCompletedCb completed_cb = nullptr)
+    {
+        return Send(data.begin(), data.size(), std::move(completed_cb));
+    }
+
+    bool Send(const std::vector<DataView>& data, SendCompletedCb completed_cb = nullptr)
+    {
+        return Send(data.data(), data.size(), std::move(completed_cb));
+    }
+
+    //
+    // Zero-copy variant for large payloads: data is not copied but must stay valid and unchanged
+    // until completed_cb is called, which is when the kernel is done with it. Applies to payloads
+    // of at least zero_copy_min_bytes on Inet connections (Linux only), others fall back to Send().
+    //
+    virtual bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) = 0;
+
+    bool SendZeroCopy(DataView data, SendCompletedCb completed_cb)
+    {
+        return SendZeroCopy(&data, 1, std::move(completed_cb));
+    }
+
+    bool SendZeroCopy(std::initializer_list<DataView> data, SendCompletedCb completed_cb)
+    {
+        return SendZeroCopy(data.begin(), data.size(), std::move(completed_cb));
+    }
+
+    //
+    // Writes out sends held back by write coalescing without waiting for its budget.
+    // Returns false if not connected.
+    //
+    virtual bool Flush() = 0;
+
+    //
+    // Stops and restarts taking data from the Server (Linux only), the data waits in the socket
+    // meanwhile and the Server is slowed down by TCP flow control. Paused from the data callback,
+    // no more data is delivered, the frames left of a chunk come first once resumed.
+    // Paused from elsewhere, a chunk already read may still be delivered.
+    //
+    virtual void PauseReading() = 0;
+    virtual void ResumeReading() = 0;
+
+    // false while the data queued for the Server is above the send watermarks
+    virtual bool IsWritable() = 0;
+
+    //
+    // Waiting for events by the I/O thread, on a shared event loop those of the thread the
+    // client is on, counting all its clients. Zero on Windows.
+    //
+    virtual PollStats GetPollStats() = 0;
 };
 
 } // namespace libsercli
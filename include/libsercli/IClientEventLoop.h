@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <memory>
+
+#ifdef __linux__
+#define DLL_EXPORT
+#else
+#define DLL_EXPORT __declspec(dllexport)
+#endif
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Fixed set of I/O threads serving any number of clients (Linux only).
+// A client created with ClientConfig::event_loop set joins one of the threads on Connect()
+// instead of starting its own. Clients keep the loop alive, its threads stop with the last one.
+//
+class DLL_EXPORT IClientEventLoop
+{
+public:
+    virtual ~IClientEventLoop() = default;
+
+    virtual size_t GetThreadCount() const = 0;
+};
+
+using IClientEventLoopPtr = std::shared_ptr<IClientEventLoop>;
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#undef DLL_EXPORT
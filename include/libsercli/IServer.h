@@ -11,11 +11,19 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "libsercli/Buffer.h"
+#include "libsercli/Callbacks.h"
+#include "libsercli/DataView.h"
+#include "libsercli/ExecutorStats.h"
+#include "libsercli/PollStats.h"
+
 #ifdef __linux__
 #define DLL_EXPORT
 #else
@@ -28,20 +36,149 @@ namespace libsercli {
 class IClientHandler;
 using IClientHandlerPtr = std::shared_ptr<IClientHandler>;
 
+//
+// Unique for the server's lifetime: the socket in the low 32 bits and how many clients had it
+// before in the high ones
+//
+using ClientId = uint64_t;
+
 class DLL_EXPORT IClientHandler
 {
 public:
     virtual ~IClientHandler() = default;
 
+    // GetClientId() as a string
     virtual const std::string& GetId() = 0;
 
+    virtual ClientId GetClientId() = 0;
+
     virtual bool IsConnected() = 0;
+
+    //
+    // Non-blocking and thread safe: data is written at once when possible, the rest is queued
+    // and written by the server in the background. Returns false if the client is gone.
+    //
     virtual bool Send(const std::vector<uint8_t>& data) = 0;
+    virtual bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) = 0;
+
+    //
+    // Scatter-gather: the buffers go out back to back in a single system call,
+    // e.g. Send({DataView(header), DataView(body)})
+    //
+    virtual bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) = 0;
+
+    bool Send(std::initializer_list<DataView> data, SendCompletedCb completed_cb = nullptr)
+    {
+        return Send(data.begin(), data.size(), std::move(completed_cb));
+    }
+
+    bool Send(const std::vector<DataView>& data, SendCompletedCb completed_cb = nullptr)
+    {
+        return Send(data.data(), data.size(), std::move(completed_cb));
+    }
+
+    //
+    // Zero-copy variant for large payloads: data is not copied but must stay valid and unchanged
+    // until completed_cb is called, which is when the kernel is done with it. Applies to payloads
+    // of at least zero_copy_min_bytes on Inet connections (Linux only), others fall back to Send().
+    //
+    virtual bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) = 0;
+
+    bool SendZeroCopy(DataView data, SendCompletedCb completed_cb)
+    {
+        return SendZeroCopy(&data, 1, std::move(completed_cb));
+    }
+
+    bool SendZeroCopy(std::initializer_list<DataView> data, SendCompletedCb completed_cb)
+    {
+        return SendZeroCopy(data.begin(), data.size(), std::move(completed_cb));
+    }
+
+    //
+    // Writes out sends held back by write coalescing without waiting for its budget.
+    // Returns false if the client is gone.
+    //
+    virtual bool Flush() = 0;
+
+    //
+    // Stops and restarts taking data from the client (Linux only), the data waits in the socket
+    // meanwhile and the client is slowed down by TCP flow control. Paused from the data callback,
+    // no more data is delivered for the client, the frames left of a chunk come first once
+    // resumed. Paused from elsewhere, a chunk already read may still be delivered.
+    //
+    virtual void PauseReading() = 0;
+    virtual void ResumeReading() = 0;
+
+    // false while the data queued for the client is above the send watermarks
+    virtual bool IsWritable() = 0;
+};
+
+//
+// Outcome of a broadcast, counted in clients
+//
+struct BroadcastResult
+{
+    size_t sent = 0;          // written or queued
+    size_t backpressured = 0; // of the sent ones, those whose socket didn't take it all at once
+    size_t skipped = 0;       // disconnected or unknown
 };
 
+using ClientFilter = std::function<bool(IClientHandler& client)>;
+
 using ClientStatusCb = std::function<void(IClientHandlerPtr client, bool connected)>;
+//
+// Reports crossing the send watermarks, from the thread that made the queue grow or shrink
+//
+using ClientWritableCb = std::function<void(IClientHandlerPtr client, bool writable)>;
+
+enum class RejectReason
+{
+    //
+    // AdmissionConfig::max_connections clients are served already: accepting pauses until one
+    // of them leaves, the connections wait in the listen backlog meanwhile. Reported once per
+    // pause, and for a connection another I/O thread accepted just before, which is closed.
+    //
+    kConnectionLimit,
+    //
+    // Out of file descriptors or memory: accepting pauses for a moment, the connections wait
+    // in the listen backlog meanwhile. Reported once per pause.
+    //
+    kOutOfResources,
+};
+
+//
+// Connections the server couldn't take on (Linux only), called from an I/O thread
+//
+using ConnectionRejectedCb = std::function<void(RejectReason reason)>;
 using ServerDataReceivedCb =
     std::function<void(IClientHandlerPtr client, const std::vector<uint8_t>& data)>;
+//
+// Zero-copy variant: data points into a receive buffer reused by the library,
+// it is valid only until the callback returns
+//
+using ServerDataViewReceivedCb = std::function<void(IClientHandlerPtr client, DataView data)>;
+//
+// Pooled variant: data may be kept after the callback returns by copying the Buffer,
+// which shares the same memory
+//
+using ServerBufferReceivedCb = std::function<void(IClientHandlerPtr client, const Buffer& data)>;
+
+//
+// Alternative to the callbacks: one virtual call per event and no client pointer copied for it.
+// Called from the same threads as the callbacks. The client is only borrowed for the call,
+// GetClient() with its id gives a pointer to keep.
+//
+class DLL_EXPORT IServerHandler
+{
+public:
+    virtual ~IServerHandler() = default;
+
+    virtual void OnClientStatus(IClientHandler& client, bool connected) = 0;
+    //
+    // data may be kept after the call returns by copying the Buffer, which shares the same memory
+    //
+    virtual void OnDataReceived(IClientHandler& client, const Buffer& data) = 0;
+};
 
 class DLL_EXPORT IServer
 {
@@ -49,10 +186,57 @@ public:
     virtual ~IServer() = default;
 
     virtual bool Start(ClientStatusCb client_status_cb, ServerDataReceivedCb server_data_received_cb) = 0;
+    virtual bool Start(
+        ClientStatusCb client_status_cb,
+        ServerDataViewReceivedCb server_data_received_cb) = 0;
+    virtual bool Start(
+        ClientStatusCb client_status_cb,
+        ServerBufferReceivedCb server_data_received_cb) = 0;
+    // handler is to outlive Stop()
+    virtual bool Start(IServerHandler& handler) = 0;
     virtual void Stop() = 0;
 
+    // To be set before Start()
+    virtual void SetClientWritableCb(ClientWritableCb client_writable_cb) = 0;
+    virtual void SetConnectionRejectedCb(ConnectionRejectedCb connection_rejected_cb) = 0;
+
     virtual std::vector<IClientHandlerPtr> GetClients() = 0;
-    virtual IClientHandlerPtr GetClient(const std::string& id) = 0;
+    //
+    // Same into the caller's vector, which keeps its capacity from one call to the next.
+    // Either way each client pointer is copied, so one reference count update per client.
+    //
+    virtual void GetClients(std::vector<IClientHandlerPtr>& clients) = 0;
+
+    //
+    // Sends the same data to all clients, to those the filter accepts or to the listed ones.
+    // The data is copied once, the outbound queues of all clients share that copy.
+    // Returns with nothing sent if the data is over the framing limit.
+    //
+    virtual BroadcastResult Broadcast(DataView data, ClientFilter filter = nullptr) = 0;
+    virtual BroadcastResult Broadcast(DataView data, const std::vector<ClientId>& ids) = 0;
+
+    //
+    // Doesn't lock, nullptr once the client is gone even if its socket was reused
+    //
+    virtual IClientHandlerPtr GetClient(ClientId id) = 0;
+
+    // Waiting for events by the reactor threads, zero on Windows
+    virtual PollStats GetPollStats() = 0;
+
+    // Callbacks run on the thread pool, zero without one
+    virtual ExecutorStats GetExecutorStats() = 0;
+
+    IClientHandlerPtr GetClient(const std::string& id)
+    {
+        try
+        {
+            return GetClient(static_cast<ClientId>(std::stoull(id)));
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
 };
 
 } // namespace libsercli
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Source of the memory the library allocates per connection and per message, after
+// std::pmr::memory_resource: client handlers, send queues, frame decoders and the buffers taken
+// beyond the receive pool, e.g. when it is exhausted or for frames larger than its buffers.
+// Called from any thread, memory may be released by another thread than the one that got it.
+// Is to outlive the server or client and whatever the application keeps of it: client handler
+// pointers and Buffers.
+//
+class MemoryResource
+{
+public:
+    virtual ~MemoryResource() = default;
+
+    virtual void* Allocate(size_t bytes, size_t alignment) = 0;
+    virtual void Deallocate(void* p, size_t bytes, size_t alignment) = 0;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// How the I/O threads waited for events since they were started, summed over all of them
+// (Linux only)
+//
+struct PollStats
+{
+    std::chrono::nanoseconds spin_time{0}; // polling without blocking, see BusyPollConfig
+    std::chrono::nanoseconds idle_time{0}; // blocked in the kernel
+    uint64_t spin_wakeups = 0;             // rounds whose events were found while spinning
+    uint64_t blocking_wakeups = 0;         // rounds whose events came after blocking
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// How much an event loop iteration reads for one connection (Linux, epoll backend only).
+// A connection over budget is put back behind the others that have events pending and is
+// read again on the next iteration, so a single busy peer can't hold up the rest.
+//
+struct ReadBudgetConfig
+{
+    //
+    // Events taken from the kernel per wakeup of an I/O thread
+    //
+    size_t max_events = 64;
+    //
+    // Bytes read per connection and iteration, 0 for no limit
+    //
+    size_t max_bytes = 256 * 1024;
+    //
+    // Chunks (frames with framing on) delivered per connection and iteration, 0 for no limit
+    //
+    size_t max_messages = 64;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
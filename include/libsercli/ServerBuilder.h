@@ -14,6 +14,7 @@
 #include <memory>
 
 #include "libsercli/IServer.h"
+#include "libsercli/ServerConfig.h"
 
 #ifdef __linux__
 #define DLL_EXPORT
@@ -26,8 +27,10 @@ namespace libsercli {
 
 using IServerPtr = std::unique_ptr<IServer>;
 
-IServerPtr DLL_EXPORT CreateUnixServer(const char* socket_path);
-IServerPtr DLL_EXPORT CreateInetServer(const char* address, int port);
+IServerPtr DLL_EXPORT
+CreateUnixServer(const char* socket_path, const ServerConfig& config = ServerConfig());
+IServerPtr DLL_EXPORT
+CreateInetServer(const char* address, int port, const ServerConfig& config = ServerConfig());
 
 } // namespace libsercli
 } // namespace nkhlab
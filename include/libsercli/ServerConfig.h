@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "libsercli/AdmissionConfig.h"
+#include "libsercli/Backend.h"
+#include "libsercli/Buffer.h"
+#include "libsercli/BusyPollConfig.h"
+#include "libsercli/ExecutorConfig.h"
+#include "libsercli/FramingConfig.h"
+#include "libsercli/MemoryResource.h"
+#include "libsercli/ReadBudgetConfig.h"
+#include "libsercli/SocketOptions.h"
+#include "libsercli/ThreadConfig.h"
+#include "libsercli/WatermarkConfig.h"
+#include "libsercli/WriteCoalescingConfig.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+struct ServerConfig
+{
+    //
+    // Number of I/O threads, each one runs its own reactor and owns its clients (Linux only).
+    // Inet servers open one SO_REUSEPORT listener per reactor, UNIX socket servers accept
+    // on the first reactor and hand connections off to all reactors round-robin.
+    //
+    size_t reactor_threads = 1;
+    //
+    // Pool received data lands in, shared by all reactors of the server
+    //
+    BufferPoolConfig receive_pool;
+    //
+    // Batching of small sends, applied to every client connection
+    //
+    WriteCoalescingConfig write_coalescing;
+    //
+    // Payloads of at least this many bytes sent with SendZeroCopy() are not copied into the
+    // kernel (Linux Inet connections only), 0 disables zero-copy
+    //
+    size_t zero_copy_min_bytes = 0;
+    //
+    // I/O mechanism, the same interface on top of either
+    //
+    Backend backend = Backend::kEpoll;
+    //
+    // Length-prefixed messages instead of a plain byte stream
+    //
+    FramingConfig framing;
+    //
+    // When the connection is reported unwritable and writable again
+    //
+    WatermarkConfig send_watermarks;
+    //
+    // Fair share of each reactor iteration for every client
+    //
+    ReadBudgetConfig read_budget;
+    //
+    // Listen backlog and connection limit
+    //
+    AdmissionConfig admission;
+    //
+    // Socket level tuning and the size of the receive buffers
+    //
+    SocketOptions socket_options;
+    //
+    // Names and CPUs of the reactor threads
+    //
+    ThreadConfig io_threads;
+    //
+    // Spinning of the reactor threads before they block
+    //
+    BusyPollConfig busy_poll;
+    //
+    // Thread pool for the received data callbacks
+    //
+    ExecutorConfig callback_executor;
+    //
+    // Per connection and per message allocations, nullptr for the global heap.
+    // Not owned, is to outlive the server, see MemoryResource.
+    //
+    MemoryResource* memory_resource = nullptr;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Tuning of the sockets a server or a client opens, zero or false keeps the system default.
+// A server sets them on its listening sockets and accepted connections inherit them.
+// Start()/Connect() fail when the system refuses one of them.
+//
+struct SocketOptions
+{
+    //
+    // TCP_NODELAY: small sends go out at once instead of waiting for outstanding ACKs (Inet only)
+    //
+    bool tcp_nodelay = false;
+    //
+    // TCP_QUICKACK: ACKs are not delayed (Inet, Linux only). The kernel may turn it off again
+    // later on, it is set once per connection.
+    //
+    bool tcp_quickack = false;
+    //
+    // SO_SNDBUF and SO_RCVBUF in bytes, the kernel doubles them for its bookkeeping
+    //
+    int send_buffer_size = 0;
+    int receive_buffer_size = 0;
+    //
+    // SO_BUSY_POLL: microseconds a blocking read spins on the device queue (Linux only),
+    // above net.core.busy_read it needs CAP_NET_ADMIN
+    //
+    int busy_poll_us = 0;
+    //
+    // SO_PRIORITY: queueing priority of outgoing packets (Linux only), above 6 it needs
+    // CAP_NET_ADMIN
+    //
+    int priority = 0;
+    //
+    // Size of the buffers received data lands in, the most a data callback gets at once
+    // without framing
+    //
+    size_t receive_chunk_size = 1024;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
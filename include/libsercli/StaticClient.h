@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libsercli/DataView.h"
+#include "libsercli/StaticPolicies.h"
+#include "libsercli/StaticSocket.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Client half of StaticServer, with its parts picked at compile time the same way (Linux only):
+// nothing on the receive path goes through a virtual call, a std::function or a lock.
+//
+// Transport:  UnixTransport or InetTransport, or a class with the same members.
+// Framing:    NoFraming or LengthFraming.
+// Handler:    any class with
+//                 void OnDisconnected(Client& client);
+//                 void OnDataReceived(Client& client, DataView data);
+//             data is valid only during the call.
+// Allocator:  for the send queue, the frame reassembly and the receive buffer.
+//
+// Lean next to IClient: one I/O thread, edge-triggered epoll. No watermarks, pausing or
+// zero-copy sends. Send() and Close() can be called from any thread, Connect() and Disconnect()
+// not from the handler calls. The handler is to outlive Disconnect().
+//
+template <
+    class Transport,
+    class Framing,
+    class Handler,
+    class Allocator = std::allocator<uint8_t>>
+class StaticClient
+{
+    using ByteAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<uint8_t>;
+    using Decoder = typename Framing::template Decoder<ByteAllocator>;
+
+public:
+    StaticClient(
+        Transport transport,
+        Handler& handler,
+        Framing framing = Framing(),
+        const Allocator& allocator = Allocator(),
+        size_t receive_chunk_size = 64 * 1024)
+        : transport_{std::move(transport)}
+        , handler_{handler}
+        , framing_{framing}
+        , byte_allocator_{allocator}
+        , receive_buffer_(receive_chunk_size > 0 ? receive_chunk_size : 1, 0, byte_allocator_)
+        , socket_{-1}
+        , epoll_fd_{-1}
+        , wake_fd_{-1}
+        , connected_{false}
+        , queue_{byte_allocator_}
+    {
+    }
+
+    StaticClient(const StaticClient&) = delete;
+    StaticClient& operator=(const StaticClient&) = delete;
+
+    ~StaticClient() { Disconnect(); }
+
+    //
+    // Blocks until connected. Returns false on failure or while still connected,
+    // after a disconnection Disconnect() is to be called before connecting again.
+    //
+    bool Connect()
+    {
+        if (worker_thread_.joinable()) return false;
+
+        socket_ = transport_.Connect();
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (socket_ == -1 || epoll_fd_ == -1 || wake_fd_ == -1 ||
+            !Watch(socket_, EPOLLIN | EPOLLOUT | EPOLLET) || !Watch(wake_fd_, EPOLLIN))
+        {
+            CloseAll();
+            return false;
+        }
+
+        transport_.Tune(socket_);
+
+        {
+            std::lock_guard<std::mutex> lk(send_mtx_);
+            connected_ = true;
+        }
+
+        worker_thread_ = std::thread(&StaticClient::Routine, this);
+        return true;
+    }
+
+    // Without reporting it
+    void Disconnect()
+    {
+        if (worker_thread_.joinable())
+        {
+            eventfd_write(wake_fd_, 1);
+            worker_thread_.join();
+        }
+
+        CloseAll();
+    }
+
+    bool IsConnected()
+    {
+        std::lock_guard<std::mutex> lk(send_mtx_);
+        return connected_;
+    }
+
+    //
+    // Writes what the socket takes at once and queues the rest until it can take more.
+    // Returns false if not connected or the data is over the framing limit.
+    //
+    bool Send(DataView data)
+    {
+        std::array<uint8_t, Framing::kHeaderSize> header;
+
+        if (!framing_.EncodeHeader(data.size(), header.data())) return false;
+
+        std::lock_guard<std::mutex> lk(send_mtx_);
+
+        if (!connected_) return false;
+
+        if (!queue_.Send(socket_, header.data(), header.size(), data))
+        {
+            shutdown(socket_, SHUT_RDWR);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Reported as disconnected by the I/O thread
+    void Close()
+    {
+        std::lock_guard<std::mutex> lk(send_mtx_);
+
+        if (connected_) shutdown(socket_, SHUT_RDWR);
+    }
+
+private:
+    static constexpr int kMaxEvents = 2;
+
+    bool Watch(int fd, uint32_t events)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = fd;
+
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != -1;
+    }
+
+    void Routine()
+    {
+        // Only the I/O thread reads, a new one with every connection
+        Decoder decoder(framing_, byte_allocator_);
+        epoll_event events[kMaxEvents];
+        bool open = true;
+
+        while (open)
+        {
+            int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+
+            if (count == -1)
+            {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            for (int i = 0; i < count && open; ++i)
+            {
+                if (events[i].data.fd == wake_fd_) return;
+
+                open = HandleEvents(decoder, events[i].events);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(send_mtx_);
+            connected_ = false;
+        }
+
+        handler_.OnDisconnected(*this);
+    }
+
+    // false once the connection is gone
+    bool HandleEvents(Decoder& decoder, uint32_t events)
+    {
+        if (events & EPOLLOUT)
+        {
+            std::lock_guard<std::mutex> lk(send_mtx_);
+
+            if (!queue_.Flush(socket_)) shutdown(socket_, SHUT_RDWR);
+        }
+
+        if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return true;
+
+        return detail::ReadAll(socket_, receive_buffer_, decoder, [&](DataView data) {
+            handler_.OnDataReceived(*this, data);
+        });
+    }
+
+    void CloseAll()
+    {
+        {
+            std::lock_guard<std::mutex> lk(send_mtx_);
+
+            connected_ = false;
+            queue_.Clear();
+
+            if (socket_ != -1) close(socket_);
+            socket_ = -1;
+        }
+
+        if (epoll_fd_ != -1) close(epoll_fd_);
+        if (wake_fd_ != -1) close(wake_fd_);
+
+        epoll_fd_ = wake_fd_ = -1;
+    }
+
+    const Transport transport_;
+    Handler& handler_;
+    const Framing framing_;
+    ByteAllocator byte_allocator_;
+    std::vector<uint8_t, ByteAllocator> receive_buffer_;
+    int socket_;
+    int epoll_fd_;
+    int wake_fd_;
+    std::thread worker_thread_;
+
+    std::mutex send_mtx_;
+    bool connected_;                         // guarded by send_mtx_
+    detail::SendQueue<ByteAllocator> queue_; // guarded by send_mtx_
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "libsercli/DataView.h"
+#include "libsercli/FrameParser.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Policies of StaticServer and StaticClient (Linux only)
+//
+
+namespace detail {
+
+template <class SockAddrT>
+int BindAndListen(int sock, const SockAddrT& addr, int backlog)
+{
+    if (sock == -1) return -1;
+
+    if (bind(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        listen(sock, backlog) == -1)
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+// Blocks until connected, the socket is non-blocking then
+template <class SockAddrT>
+int Connect(int sock, const SockAddrT& addr)
+{
+    if (sock == -1) return -1;
+
+    int flags = -1;
+
+    if (connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        (flags = fcntl(sock, F_GETFL, 0)) == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+} // namespace detail
+
+//
+// Transports: open the non-blocking listening or connected socket and set up the accepted and
+// connected ones
+//
+
+class UnixTransport
+{
+public:
+    explicit UnixTransport(std::string path)
+        : path_{std::move(path)}
+    {
+    }
+
+    // -1 on failure
+    int Listen(int backlog) const
+    {
+        unlink(path_.c_str()); // Remove any existing socket file
+
+        return detail::BindAndListen(
+            socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), GetAddr(), backlog);
+    }
+
+    // -1 on failure
+    int Connect() const
+    {
+        return detail::Connect(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), GetAddr());
+    }
+
+    void Close(int sock) const
+    {
+        close(sock);
+        unlink(path_.c_str()); // Remove socket file after use
+    }
+
+    void Tune(int sock) const { (void)sock; }
+
+private:
+    sockaddr_un GetAddr() const
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    const std::string path_;
+};
+
+class InetTransport
+{
+public:
+    InetTransport(std::string address, int port, bool tcp_nodelay = true)
+        : address_{std::move(address)}
+        , port_{port}
+        , tcp_nodelay_{tcp_nodelay}
+    {
+    }
+
+    // -1 on failure
+    int Listen(int backlog) const
+    {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+
+        // The same as SocketServer: rebinds while connections it closed are in TIME_WAIT
+        if (sock != -1) setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        return detail::BindAndListen(sock, GetAddr(), backlog);
+    }
+
+    // -1 on failure
+    int Connect() const
+    {
+        return detail::Connect(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), GetAddr());
+    }
+
+    void Close(int sock) const { close(sock); }
+
+    void Tune(int sock) const
+    {
+        int on = 1;
+
+        if (tcp_nodelay_) setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+private:
+    sockaddr_in GetAddr() const
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(address_.c_str());
+        addr.sin_port = htons(static_cast<uint16_t>(port_));
+        return addr;
+    }
+
+    const std::string address_;
+    const int port_;
+    const bool tcp_nodelay_;
+};
+
+//
+// Framings: cut the received stream into messages and make the header of outgoing ones.
+// Decoder::Feed() returns false when the stream can't be followed any more.
+//
+
+// Stream chunks as they are read
+struct NoFraming
+{
+    static constexpr size_t kHeaderSize = 0;
+
+    // false when the payload is over the limit
+    bool EncodeHeader(size_t size, uint8_t* header) const
+    {
+        (void)size;
+        (void)header;
+        return true;
+    }
+
+    template <class ByteAllocator>
+    class Decoder
+    {
+    public:
+        Decoder(const NoFraming&, const ByteAllocator&) {}
+
+        template <class FrameCb>
+        bool Feed(const uint8_t* data, size_t size, FrameCb&& frame_cb)
+        {
+            frame_cb(DataView(data, size));
+            return true;
+        }
+    };
+};
+
+//
+// The framing of FramingConfig, so either side can be an IServer/IClient. A message that arrives
+// in one chunk is handed out without a copy.
+//
+struct LengthFraming
+{
+    static constexpr size_t kHeaderSize = kFrameHeaderSize;
+
+    // Receiving a larger message closes the connection
+    size_t max_frame_size = 1024 * 1024;
+
+    bool EncodeHeader(size_t size, uint8_t* header) const
+    {
+        return EncodeFrameHeader(size, max_frame_size, header);
+    }
+
+    template <class ByteAllocator>
+    class Decoder
+    {
+    public:
+        Decoder(const LengthFraming& framing, const ByteAllocator& allocator)
+            : parser_{framing.max_frame_size, Reassembly(allocator)}
+        {
+        }
+
+        template <class FrameCb>
+        bool Feed(const uint8_t* data, size_t size, FrameCb&& frame_cb)
+        {
+            size_t consumed = 0;
+
+            return parser_.Feed(
+                data,
+                size,
+                [&](size_t pos, size_t len) {
+                    frame_cb(DataView(data + pos, len));
+                    return true;
+                },
+                [&](Reassembly& reassembly) {
+                    frame_cb(reassembly.GetFrame());
+                    return true;
+                },
+                &consumed);
+        }
+
+    private:
+        class Reassembly
+        {
+        public:
+            explicit Reassembly(const ByteAllocator& allocator)
+                : frame_(allocator)
+            {
+            }
+
+            void Begin(size_t frame_size)
+            {
+                frame_.clear();
+                frame_.reserve(frame_size);
+            }
+
+            void Append(const uint8_t* data, size_t size)
+            {
+                frame_.insert(frame_.end(), data, data + size);
+            }
+
+            DataView GetFrame() const { return DataView(frame_.data(), frame_.size()); }
+
+        private:
+            std::vector<uint8_t, ByteAllocator> frame_;
+        };
+
+        FrameParser<Reassembly> parser_;
+    };
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "libsercli/DataView.h"
+#include "libsercli/StaticPolicies.h"
+#include "libsercli/StaticSocket.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Header-only server with its parts picked at compile time (Linux only): nothing on the receive
+// path goes through a virtual call or a std::function, the compiler can inline the framing and
+// the handler into the read loop.
+//
+// Transport:  UnixTransport or InetTransport, or a class with the same members.
+// Framing:    NoFraming or LengthFraming.
+// Handler:    any class with
+//                 void OnClientStatus(Connection& connection, bool connected);
+//                 void OnDataReceived(Connection& connection, DataView data);
+//             data is valid only during the call.
+// Allocator:  for the connections, their queues and the receive buffer.
+//
+// Lean next to IServer: one I/O thread, edge-triggered epoll. No admission control, read budget,
+// write coalescing or watermarks. Connections are only to be used from the handler calls,
+// the handler is to outlive Stop().
+//
+template <
+    class Transport,
+    class Framing,
+    class Handler,
+    class Allocator = std::allocator<uint8_t>>
+class StaticServer
+{
+    using ByteAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<uint8_t>;
+    using Decoder = typename Framing::template Decoder<ByteAllocator>;
+
+public:
+    class Connection
+    {
+    public:
+        int GetSocket() const { return socket_; }
+        bool IsConnected() const { return connected_; }
+
+        //
+        // Writes what the socket takes at once and queues the rest until it can take more.
+        // Returns false if the connection is closed or the data is over the framing limit.
+        //
+        bool Send(DataView data)
+        {
+            if (!connected_) return false;
+
+            std::array<uint8_t, Framing::kHeaderSize> header;
+
+            if (!server_.framing_.EncodeHeader(data.size(), header.data())) return false;
+
+            if (!queue_.Send(socket_, header.data(), header.size(), data))
+            {
+                Close();
+                return false;
+            }
+
+            return true;
+        }
+
+        // Reported as disconnected after the handler call returns
+        void Close() { shutdown(socket_, SHUT_RDWR); }
+
+    private:
+        friend class StaticServer;
+
+        Connection(StaticServer& server, int socket)
+            : server_{server}
+            , socket_{socket}
+            , connected_{true}
+            , decoder_{server.framing_, server.byte_allocator_}
+            , queue_{server.byte_allocator_}
+        {
+        }
+
+        StaticServer& server_;
+        const int socket_;
+        bool connected_;
+        Decoder decoder_;
+        detail::SendQueue<ByteAllocator> queue_;
+    };
+
+    StaticServer(
+        Transport transport,
+        Handler& handler,
+        Framing framing = Framing(),
+        const Allocator& allocator = Allocator(),
+        size_t receive_chunk_size = 64 * 1024)
+        : transport_{std::move(transport)}
+        , handler_{handler}
+        , framing_{framing}
+        , byte_allocator_{allocator}
+        , connection_allocator_{allocator}
+        , receive_buffer_(receive_chunk_size > 0 ? receive_chunk_size : 1, 0, byte_allocator_)
+        , connections_{ConnectionPtrAllocator(allocator)}
+        , listener_{-1}
+        , epoll_fd_{-1}
+        , wake_fd_{-1}
+        , retry_fd_{-1}
+    {
+    }
+
+    StaticServer(const StaticServer&) = delete;
+    StaticServer& operator=(const StaticServer&) = delete;
+
+    ~StaticServer() { Stop(); }
+
+    bool Start()
+    {
+        if (worker_thread_.joinable()) return false;
+
+        listener_ = transport_.Listen(SOMAXCONN);
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        retry_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        //
+        // Edge-triggered listener: reported only when a connection comes in, so every round of
+        // accepting runs until EAGAIN, see Accept()
+        //
+        if (listener_ == -1 || epoll_fd_ == -1 || wake_fd_ == -1 || retry_fd_ == -1 ||
+            !Watch(listener_, EPOLLIN | EPOLLET, &listener_) ||
+            !Watch(wake_fd_, EPOLLIN, &wake_fd_) || !Watch(retry_fd_, EPOLLIN, &retry_fd_))
+        {
+            CloseAll();
+            return false;
+        }
+
+        worker_thread_ = std::thread(&StaticServer::Routine, this);
+        return true;
+    }
+
+    // Closes the connections without reporting them
+    void Stop()
+    {
+        if (worker_thread_.joinable())
+        {
+            eventfd_write(wake_fd_, 1);
+            worker_thread_.join();
+        }
+
+        CloseAll();
+    }
+
+private:
+    using ConnectionAllocator =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Connection>;
+    using ConnectionTraits = std::allocator_traits<ConnectionAllocator>;
+    using ConnectionPtrAllocator =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Connection*>;
+
+    static constexpr int kMaxEvents = 64;
+    static constexpr long kAcceptRetryDelay_ns = 100 * 1000 * 1000;
+
+    bool Watch(int fd, uint32_t events, void* tag)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.ptr = tag;
+
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != -1;
+    }
+
+    void Routine()
+    {
+        epoll_event events[kMaxEvents];
+
+        while (true)
+        {
+            int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+
+            if (count == -1)
+            {
+                if (errno == EINTR) continue;
+                return;
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                void* tag = events[i].data.ptr;
+
+                if (tag == &wake_fd_) return;
+
+                if (tag == &retry_fd_)
+                {
+                    uint64_t expirations;
+                    if (read(retry_fd_, &expirations, sizeof(expirations)) > 0) Accept();
+                }
+                else if (tag == &listener_)
+                    Accept();
+                else
+                    HandleEvents(*static_cast<Connection*>(tag), events[i].events);
+            }
+        }
+    }
+
+    //
+    // Drains the backlog until EAGAIN: connections left behind would wait for the next one to
+    // come in. When accepting fails otherwise, e.g. out of file descriptors, the rest is taken
+    // after a delay instead of spinning on the failure.
+    //
+    void Accept()
+    {
+        while (true)
+        {
+            int sock = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (sock == -1)
+            {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) continue;
+
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    itimerspec spec = {};
+                    spec.it_value.tv_nsec = kAcceptRetryDelay_ns;
+                    timerfd_settime(retry_fd_, 0, &spec, nullptr);
+                }
+                return;
+            }
+
+            transport_.Tune(sock);
+
+            Connection* connection = ConnectionTraits::allocate(connection_allocator_, 1);
+            new (connection) Connection(*this, sock);
+
+            if (!Watch(sock, EPOLLIN | EPOLLOUT | EPOLLET, connection))
+            {
+                Destroy(connection);
+                continue;
+            }
+
+            if (static_cast<size_t>(sock) >= connections_.size())
+                connections_.resize(static_cast<size_t>(sock) + 1, nullptr);
+            connections_[static_cast<size_t>(sock)] = connection;
+
+            handler_.OnClientStatus(*connection, true);
+        }
+    }
+
+    void HandleEvents(Connection& connection, uint32_t events)
+    {
+        if ((events & EPOLLOUT) && !connection.queue_.Flush(connection.socket_)) connection.Close();
+
+        if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+
+        bool open = detail::ReadAll(
+            connection.socket_, receive_buffer_, connection.decoder_, [&](DataView data) {
+                handler_.OnDataReceived(connection, data);
+            });
+
+        if (open) return;
+
+        connections_[static_cast<size_t>(connection.socket_)] = nullptr;
+        connection.connected_ = false;
+        handler_.OnClientStatus(connection, false);
+
+        Destroy(&connection);
+    }
+
+    // Closes the socket too
+    void Destroy(Connection* connection)
+    {
+        close(connection->socket_);
+
+        connection->~Connection();
+        ConnectionTraits::deallocate(connection_allocator_, connection, 1);
+    }
+
+    void CloseAll()
+    {
+        for (auto& connection : connections_)
+        {
+            if (connection) Destroy(connection);
+            connection = nullptr;
+        }
+
+        if (listener_ != -1) transport_.Close(listener_);
+        if (epoll_fd_ != -1) close(epoll_fd_);
+        if (wake_fd_ != -1) close(wake_fd_);
+        if (retry_fd_ != -1) close(retry_fd_);
+
+        listener_ = epoll_fd_ = wake_fd_ = retry_fd_ = -1;
+    }
+
+    const Transport transport_;
+    Handler& handler_;
+    const Framing framing_;
+    ByteAllocator byte_allocator_;
+    ConnectionAllocator connection_allocator_;
+    std::vector<uint8_t, ByteAllocator> receive_buffer_; // the connections are served in turn
+    std::vector<Connection*, ConnectionPtrAllocator> connections_; // by socket
+    int listener_;
+    int epoll_fd_;
+    int wake_fd_;
+    int retry_fd_; // takes the rest of the backlog after accepting failed
+    std::thread worker_thread_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
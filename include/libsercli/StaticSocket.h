@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include "libsercli/DataView.h"
+
+namespace nkhlab {
+namespace libsercli {
+namespace detail {
+
+//
+// Socket I/O shared by StaticServer and StaticClient (Linux only)
+//
+
+//
+// Outgoing data of a non-blocking socket: written at once while nothing is queued,
+// what the socket doesn't take is queued until it can take more
+//
+template <class ByteAllocator>
+class SendQueue
+{
+public:
+    explicit SendQueue(const ByteAllocator& allocator)
+        : pending_(allocator)
+        , pending_pos_{0}
+    {
+    }
+
+    // The header and the data with one system call, false on a broken connection
+    bool Send(int sock, const uint8_t* header, size_t header_size, DataView data)
+    {
+        size_t written = 0;
+
+        // Queued data goes first
+        if (pending_.empty())
+        {
+            iovec iov[2] = {
+                {const_cast<uint8_t*>(header), header_size},
+                {const_cast<uint8_t*>(data.data()), data.size()}};
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = 2;
+
+            ssize_t bytes_written;
+            do
+            {
+                bytes_written = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            } while (bytes_written == -1 && errno == EINTR);
+
+            if (bytes_written == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            }
+            else
+            {
+                written = static_cast<size_t>(bytes_written);
+            }
+        }
+
+        if (written < header_size)
+            pending_.insert(pending_.end(), header + written, header + header_size);
+
+        written = written > header_size ? written - header_size : 0;
+        pending_.insert(pending_.end(), data.begin() + written, data.end());
+
+        return true;
+    }
+
+    // Writes out the queue, false on a broken connection
+    bool Flush(int sock)
+    {
+        while (pending_pos_ < pending_.size())
+        {
+            ssize_t bytes_written = send(
+                sock,
+                pending_.data() + pending_pos_,
+                pending_.size() - pending_pos_,
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+
+            if (bytes_written == -1)
+            {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+
+            pending_pos_ += static_cast<size_t>(bytes_written);
+        }
+
+        Clear();
+        return true;
+    }
+
+    void Clear()
+    {
+        pending_.clear();
+        pending_pos_ = 0;
+    }
+
+private:
+    std::vector<uint8_t, ByteAllocator> pending_; // not taken by the socket yet
+    size_t pending_pos_;                          // written part of pending_
+};
+
+//
+// Reads a socket until EAGAIN, as edge-triggered epoll needs it, and feeds every chunk to the
+// decoder. Returns false once the connection is closed or broken, or a frame is over the limit
+// and the stream can't be followed any more.
+//
+template <class Buffer, class Decoder, class FrameCb>
+bool ReadAll(int sock, Buffer& buffer, Decoder& decoder, FrameCb&& frame_cb)
+{
+    while (true)
+    {
+        ssize_t bytes_read = read(sock, buffer.data(), buffer.size());
+
+        if (bytes_read > 0)
+        {
+            if (!decoder.Feed(buffer.data(), static_cast<size_t>(bytes_read), frame_cb))
+                return false;
+        }
+        else if (bytes_read == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+}
+
+} // namespace detail
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
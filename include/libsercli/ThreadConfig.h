@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Naming and placement of the I/O threads a server, a client or an event loop starts
+// (Linux only)
+//
+struct ThreadConfig
+{
+    //
+    // Thread name, the thread index is appended and the result cut to 15 characters.
+    // Empty for a default name telling servers, clients and event loops apart.
+    //
+    std::string name;
+    //
+    // CPUs the threads are pinned to, thread i runs on cpus[i % cpus.size()].
+    // Empty leaves the threads to the scheduler.
+    //
+    std::vector<int> cpus;
+    //
+    // Each pinned thread gets its own share of the receive pool, allocated on the NUMA node
+    // of its CPU. Clients on a shared event loop keep their pool where it is.
+    //
+    bool numa_local_buffers = false;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
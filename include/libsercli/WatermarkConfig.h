@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Limits on the data waiting to be sent to one connection (Linux only).
+// Once high bytes are queued the connection turns unwritable, once they drain to low it turns
+// writable again, both changes are reported to the writable callback. Sends are still accepted
+// while unwritable, the callback decides what to do about a slow reader.
+//
+struct WatermarkConfig
+{
+    //
+    // 0 disables the watermarks
+    //
+    size_t high = 0;
+    //
+    // Not above high
+    //
+    size_t low = 0;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Opt-in batching of small sends made to one connection (Linux only).
+// A send smaller than max_bytes is held back until max_bytes are queued, max_delay has passed,
+// the connection's reactor has handled its events or Flush() is called, whichever comes first.
+// All held back sends then go out in a single system call.
+//
+struct WriteCoalescingConfig
+{
+    //
+    // Byte budget, 0 disables coalescing
+    //
+    size_t max_bytes = 0;
+    //
+    // Latency budget: the longest a held back send waits for more data
+    //
+    std::chrono::microseconds max_delay{50};
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include "libsercli/Backend.h"
+
+#include "UringReactor.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+bool IsBackendSupported(Backend backend)
+{
+#ifdef __linux__
+    if (backend == Backend::kIoUring) return IsIoUringSupported();
+    return true;
+#else
+    return backend == Backend::kEpoll;
+#endif
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#include "BufferPool.h"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <new>
+
+#include "Macros.h"
+#include "ResourceAllocator.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+#ifdef __linux__
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+#endif
+
+//
+// Buffer
+//
+
+Buffer::Buffer()
+    : block_{nullptr}
+    , offset_{0}
+    , size_{0}
+{
+}
+
+Buffer::Buffer(BufferBlock* block)
+    : block_{block}
+    , offset_{0}
+    , size_{0}
+{
+}
+
+Buffer::~Buffer()
+{
+    Reset();
+}
+
+Buffer::Buffer(const Buffer& other)
+    : block_{other.block_}
+    , offset_{other.offset_}
+    , size_{other.size_}
+{
+    if (block_) block_->ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+    : block_{other.block_}
+    , offset_{other.offset_}
+    , size_{other.size_}
+{
+    other.block_ = nullptr;
+    other.offset_ = other.size_ = 0;
+}
+
+Buffer& Buffer::operator=(const Buffer& other)
+{
+    if (block_ != other.block_)
+    {
+        if (other.block_) other.block_->ref_count.fetch_add(1, std::memory_order_relaxed);
+        Reset();
+        block_ = other.block_;
+    }
+
+    offset_ = other.offset_;
+    size_ = other.size_;
+
+    return *this;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        block_ = other.block_;
+        offset_ = other.offset_;
+        size_ = other.size_;
+        other.block_ = nullptr;
+        other.offset_ = other.size_ = 0;
+    }
+
+    return *this;
+}
+
+const uint8_t* Buffer::data() const
+{
+    return block_ ? block_->data + offset_ : nullptr;
+}
+
+size_t Buffer::size() const
+{
+    return size_;
+}
+
+size_t Buffer::UseCount() const
+{
+    return block_ ? block_->ref_count.load(std::memory_order_acquire) : 0;
+}
+
+void Buffer::Reset()
+{
+    if (block_)
+    {
+        if (block_->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            BufferPool::ReleaseBlock(block_);
+
+        block_ = nullptr;
+    }
+
+    offset_ = size_ = 0;
+}
+
+//
+// BufferPool
+//
+
+void BufferPoolDeleter::operator()(BufferPool* pool) const
+{
+    pool->Unref();
+}
+
+BufferPoolPtr BufferPool::Create(
+    size_t buffer_size,
+    const BufferPoolConfig& config,
+    int numa_node,
+    MemoryResource* resource)
+{
+    return BufferPoolPtr(new BufferPool(buffer_size, config, numa_node, resource));
+}
+
+BufferPool::BufferPool(
+    size_t buffer_size,
+    const BufferPoolConfig& config,
+    int numa_node,
+    MemoryResource* resource)
+    : buffer_size_{std::max<size_t>(buffer_size, 1)} // an empty read would look like EOF
+    , resource_{resource}
+    , slab_{nullptr}
+    , slab_size_{buffer_size_ * config.buffer_count}
+    , slab_mapped_{false}
+    , blocks_(config.buffer_count)
+    , refs_{1}
+{
+    if (slab_size_ == 0) return;
+
+#ifdef __linux__
+    if (config.huge_pages)
+    {
+        size_t huge_size = (slab_size_ + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+
+        void* mem = mmap(
+            nullptr,
+            huge_size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0);
+
+        if (mem == MAP_FAILED)
+        {
+            // No huge pages reserved, ask for transparent ones
+            mem = mmap(
+                nullptr, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem != MAP_FAILED) madvise(mem, huge_size, MADV_HUGEPAGE);
+        }
+
+        if (mem != MAP_FAILED)
+        {
+            slab_ = static_cast<uint8_t*>(mem);
+            slab_size_ = huge_size;
+            slab_mapped_ = true;
+        }
+    }
+
+    if (numa_node >= 0)
+    {
+        if (!slab_)
+        {
+            void* mem = mmap(
+                nullptr, slab_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (mem != MAP_FAILED)
+            {
+                slab_ = static_cast<uint8_t*>(mem);
+                slab_mapped_ = true;
+            }
+        }
+
+        //
+        // Pages are not touched yet, they are allocated on the node on first use.
+        // Preferred only: a full node falls back to the others.
+        // The kernel reads maxnode - 1 bits of the mask, so it is one more than the bits in it.
+        //
+        unsigned long node_mask = 0;
+        constexpr unsigned long kMaxNodes = sizeof(node_mask) * 8;
+
+        if (slab_mapped_ && static_cast<unsigned long>(numa_node) < kMaxNodes)
+        {
+            node_mask = 1UL << numa_node;
+            syscall(SYS_mbind, slab_, slab_size_, MPOL_PREFERRED, &node_mask, kMaxNodes + 1, 0);
+        }
+    }
+#else
+    UNUSED(numa_node);
+#endif
+
+    if (!slab_) slab_ = new uint8_t[slab_size_];
+
+    free_blocks_.reserve(blocks_.size());
+
+    for (size_t i = 0; i < blocks_.size(); ++i)
+    {
+        BufferBlock& block = blocks_[i];
+
+        block.ref_count = 0;
+        block.capacity = buffer_size_;
+        block.data = slab_ + i * buffer_size_;
+        block.pool = this;
+        block.resource = nullptr;
+
+        free_blocks_.push_back(&block);
+    }
+}
+
+BufferPool::~BufferPool()
+{
+#ifdef __linux__
+    if (slab_mapped_)
+    {
+        munmap(slab_, slab_size_);
+        return;
+    }
+#endif
+    delete[] slab_;
+}
+
+Buffer BufferPool::Acquire()
+{
+    BufferBlock* block = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lk(free_blocks_mtx_);
+
+        if (!free_blocks_.empty())
+        {
+            block = free_blocks_.back();
+            free_blocks_.pop_back();
+        }
+    }
+
+    // Pool is exhausted
+    if (!block) return Allocate(buffer_size_, resource_);
+
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    block->ref_count.store(1, std::memory_order_relaxed);
+
+    return Buffer(block);
+}
+
+Buffer BufferPool::Allocate(size_t capacity, MemoryResource* resource)
+{
+    // Header and data in one heap allocation
+    uint8_t* mem = static_cast<uint8_t*>(
+        AllocateFrom(resource, sizeof(BufferBlock) + capacity, alignof(BufferBlock)));
+
+    BufferBlock* block = new (mem) BufferBlock;
+    block->capacity = capacity;
+    block->data = mem + sizeof(BufferBlock);
+    block->pool = nullptr;
+    block->resource = resource;
+    block->ref_count.store(1, std::memory_order_relaxed);
+
+    return Buffer(block);
+}
+
+void BufferPool::ReleaseBlock(BufferBlock* block)
+{
+    if (block->pool)
+    {
+        block->pool->Return(block);
+    }
+    else
+    {
+        MemoryResource* resource = block->resource;
+        size_t size = sizeof(BufferBlock) + block->capacity;
+
+        block->~BufferBlock();
+        DeallocateTo(resource, block, size, alignof(BufferBlock));
+    }
+}
+
+void BufferPool::Return(BufferBlock* block)
+{
+    {
+        std::lock_guard<std::mutex> lk(free_blocks_mtx_);
+        free_blocks_.push_back(block);
+    }
+
+    Unref();
+}
+
+void BufferPool::Unref()
+{
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "libsercli/Buffer.h"
+#include "libsercli/MemoryResource.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+class BufferPool;
+
+struct BufferBlock
+{
+    std::atomic<uint32_t> ref_count;
+    size_t capacity;
+    uint8_t* data;
+    BufferPool* pool; // nullptr for a heap block allocated when the pool was exhausted
+    MemoryResource* resource; // of a heap block, nullptr for the global heap
+};
+
+struct BufferPoolDeleter
+{
+    void operator()(BufferPool* pool) const;
+};
+
+using BufferPoolPtr = std::unique_ptr<BufferPool, BufferPoolDeleter>;
+
+//
+// Slab of fixed-size buffers with a free list.
+// The pool lives until its owner and all the buffers taken from it are gone,
+// so callbacks may keep buffers after the server or client is destroyed.
+//
+class BufferPool
+{
+public:
+    //
+    // numa_node: node the buffers are allocated on (Linux only), -1 for no preference.
+    // resource: for the buffers beyond the pool, nullptr for the global heap.
+    //
+    static BufferPoolPtr Create(
+        size_t buffer_size,
+        const BufferPoolConfig& config,
+        int numa_node = -1,
+        MemoryResource* resource = nullptr);
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    Buffer Acquire();
+
+    // Heap buffer of any capacity, for data that doesn't fit the pool's buffers
+    static Buffer Allocate(size_t capacity, MemoryResource* resource = nullptr);
+
+    size_t GetBufferSize() const { return buffer_size_; }
+    MemoryResource* GetResource() const { return resource_; }
+
+    static uint8_t* MutableData(Buffer& buffer) { return buffer.block_->data; }
+    static size_t Capacity(const Buffer& buffer) { return buffer.block_->capacity; }
+    static void SetSize(Buffer& buffer, size_t size) { buffer.size_ = size; }
+
+    // Part of buffer sharing its memory
+    static Buffer Slice(const Buffer& buffer, size_t offset, size_t size)
+    {
+        Buffer slice(buffer);
+        slice.offset_ += offset;
+        slice.size_ = size;
+        return slice;
+    }
+
+    static void ReleaseBlock(BufferBlock* block);
+
+private:
+    BufferPool(
+        size_t buffer_size,
+        const BufferPoolConfig& config,
+        int numa_node,
+        MemoryResource* resource);
+    ~BufferPool();
+
+    void Return(BufferBlock* block);
+    void Unref();
+
+    const size_t buffer_size_;
+    MemoryResource* const resource_;
+    uint8_t* slab_;
+    size_t slab_size_;
+    bool slab_mapped_;
+    std::vector<BufferBlock> blocks_;
+    std::vector<BufferBlock*> free_blocks_;
+    std::mutex free_blocks_mtx_;
+    std::atomic_size_t refs_; // owner + buffers handed out
+
+    friend struct BufferPoolDeleter;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "libsercli/IClient.h"
+#include "libsercli/IServer.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Servers and clients only call Buffer callbacks, the other kinds are wrapped into one
+//
+
+//
+// Compatibility layer: copy into a vector reused by the calling thread
+//
+inline ServerBufferReceivedCb ToBufferReceivedCb(ServerDataReceivedCb data_received_cb)
+{
+    if (!data_received_cb) return nullptr;
+
+    return [data_received_cb](IClientHandlerPtr client, const Buffer& data) {
+        thread_local std::vector<uint8_t> buffer;
+
+        buffer.assign(data.begin(), data.end());
+        data_received_cb(client, buffer);
+    };
+}
+
+inline ServerBufferReceivedCb ToBufferReceivedCb(ServerDataViewReceivedCb data_received_cb)
+{
+    if (!data_received_cb) return nullptr;
+
+    return [data_received_cb](IClientHandlerPtr client, const Buffer& data) {
+        data_received_cb(client, data.View());
+    };
+}
+
+inline ClientBufferReceivedCb ToBufferReceivedCb(ClientDataReceivedCb data_received_cb)
+{
+    if (!data_received_cb) return nullptr;
+
+    return [data_received_cb](const Buffer& data) {
+        thread_local std::vector<uint8_t> buffer;
+
+        buffer.assign(data.begin(), data.end());
+        data_received_cb(buffer);
+    };
+}
+
+inline ClientBufferReceivedCb ToBufferReceivedCb(ClientDataViewReceivedCb data_received_cb)
+{
+    if (!data_received_cb) return nullptr;
+
+    return [data_received_cb](const Buffer& data) { data_received_cb(data.View()); };
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include "CallbackExecutor.h"
+
+#include <algorithm>
+
+#include "Constants.h"
+#include "ThreadPlacement.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+namespace {
+
+// Worker the calling thread is, if it is one
+thread_local const CallbackExecutor* tls_executor = nullptr;
+thread_local size_t tls_worker = 0;
+
+} // namespace
+
+CallbackExecutor::CallbackExecutor(size_t threads)
+    : next_worker_{0}
+    , queued_{0}
+    , stopping_{false}
+    , callbacks_{0}
+    , total_delay_ns_{0}
+    , max_delay_ns_{0}
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+        workers_.emplace_back(std::make_unique<Worker>());
+}
+
+CallbackExecutor::~CallbackExecutor()
+{
+    Stop();
+}
+
+void CallbackExecutor::Start()
+{
+    if (workers_[0]->thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lk(idle_mtx_);
+        stopping_ = false;
+    }
+
+    for (size_t i = 0; i < workers_.size(); ++i)
+        workers_[i]->thread = std::thread(&CallbackExecutor::Routine, this, i);
+}
+
+void CallbackExecutor::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(idle_mtx_);
+        stopping_ = true;
+    }
+    idle_cv_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void CallbackExecutor::Post(const CallbackStrandPtr& strand, std::function<void()> task)
+{
+    bool schedule = false;
+
+    {
+        std::lock_guard<std::mutex> lk(strand->tasks_mtx_);
+
+        strand->tasks_.push_back({std::move(task), CallbackStrand::Clock::now()});
+
+        if (!strand->scheduled_) schedule = strand->scheduled_ = true;
+    }
+
+    if (schedule) Schedule(strand);
+}
+
+ExecutorStats CallbackExecutor::GetStats() const
+{
+    ExecutorStats stats;
+
+    stats.callbacks = callbacks_.load(std::memory_order_relaxed);
+    stats.total_queue_delay =
+        std::chrono::nanoseconds(total_delay_ns_.load(std::memory_order_relaxed));
+    stats.max_queue_delay = std::chrono::nanoseconds(max_delay_ns_.load(std::memory_order_relaxed));
+
+    return stats;
+}
+
+void CallbackExecutor::Routine(size_t index)
+{
+    tls_executor = this;
+    tls_worker = index;
+
+    ThreadPlacement placement = GetThreadPlacement(ThreadConfig(), "sercli-cb", index);
+    ApplyThreadPlacement(placement);
+
+    for (;;)
+    {
+        if (CallbackStrandPtr strand = Take(index))
+        {
+            Run(strand);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(idle_mtx_);
+
+        idle_cv_.wait(lk, [&]() { return queued_ > 0 || stopping_; });
+
+        // Whatever is queued still runs
+        if (stopping_ && queued_ <= 0) break;
+    }
+
+    tls_executor = nullptr;
+}
+
+void CallbackExecutor::Schedule(CallbackStrandPtr strand)
+{
+    // A worker keeps its own strands, they are likely still in its cache
+    size_t index = tls_executor == this ? tls_worker : next_worker_++ % workers_.size();
+    Worker& worker = *workers_[index];
+
+    {
+        std::lock_guard<std::mutex> lk(worker.strands_mtx);
+        worker.strands.push_back(std::move(strand));
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(idle_mtx_);
+        ++queued_;
+    }
+    idle_cv_.notify_one();
+}
+
+CallbackStrandPtr CallbackExecutor::Take(size_t index)
+{
+    // Own queue from the front, so strands of one worker run in turn
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        Worker& worker = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lk(worker.strands_mtx);
+
+        if (worker.strands.empty()) continue;
+
+        CallbackStrandPtr strand;
+
+        if (i == 0)
+        {
+            strand = std::move(worker.strands.front());
+            worker.strands.pop_front();
+        }
+        else
+        {
+            // Stolen from the back, the strand its owner would get to last
+            strand = std::move(worker.strands.back());
+            worker.strands.pop_back();
+        }
+
+        --queued_;
+        return strand;
+    }
+
+    return nullptr;
+}
+
+void CallbackExecutor::Run(const CallbackStrandPtr& strand)
+{
+    for (size_t i = 0; i < kStrandBatch; ++i)
+    {
+        CallbackStrand::Task task;
+
+        {
+            std::lock_guard<std::mutex> lk(strand->tasks_mtx_);
+
+            if (strand->tasks_.empty())
+            {
+                strand->scheduled_ = false;
+                return;
+            }
+
+            task = std::move(strand->tasks_.front());
+            strand->tasks_.pop_front();
+        }
+
+        CountDelay(CallbackStrand::Clock::now() - task.posted);
+        task.run();
+    }
+
+    // Other strands get their turn before this one goes on
+    Schedule(strand);
+}
+
+void CallbackExecutor::CountDelay(CallbackStrand::Clock::duration delay)
+{
+    auto ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count());
+
+    callbacks_.fetch_add(1, std::memory_order_relaxed);
+    total_delay_ns_.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = max_delay_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_delay_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ExecutorStats.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+class CallbackExecutor;
+
+//
+// Serial queue of tasks, those posted to one strand run one at a time in posting order
+//
+class CallbackStrand
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Task
+    {
+        std::function<void()> run;
+        Clock::time_point posted;
+    };
+
+    std::mutex tasks_mtx_;
+    std::deque<Task> tasks_;
+    bool scheduled_ = false; // queued in or run by a worker
+
+    friend class CallbackExecutor;
+};
+
+using CallbackStrandPtr = std::shared_ptr<CallbackStrand>;
+
+//
+// Work-stealing thread pool running strands. Each worker takes strands from its own queue first,
+// strands it reschedules itself stay there, then steals from the other workers. Strands posted
+// from other threads are spread over the workers round-robin.
+//
+class CallbackExecutor
+{
+public:
+    explicit CallbackExecutor(size_t threads);
+    ~CallbackExecutor();
+
+    CallbackExecutor(const CallbackExecutor&) = delete;
+    CallbackExecutor& operator=(const CallbackExecutor&) = delete;
+
+    void Start();
+    //
+    // Runs what is still queued, then joins the workers.
+    // Not to be called from a task, tasks posted afterwards don't run until the next Start().
+    //
+    void Stop();
+
+    // Thread safe
+    void Post(const CallbackStrandPtr& strand, std::function<void()> task);
+
+    // Thread safe
+    ExecutorStats GetStats() const;
+
+private:
+    struct Worker
+    {
+        std::mutex strands_mtx;
+        std::deque<CallbackStrandPtr> strands;
+        std::thread thread;
+    };
+
+    void Routine(size_t index);
+    void Schedule(CallbackStrandPtr strand);
+    CallbackStrandPtr Take(size_t index);
+    void Run(const CallbackStrandPtr& strand);
+    void CountDelay(CallbackStrand::Clock::duration delay);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic_size_t next_worker_;
+
+    // Strands queued in all workers, may go below 0 for a moment when a strand is stolen
+    // right after being queued
+    std::atomic_long queued_;
+    bool stopping_;
+    std::mutex idle_mtx_;
+    std::condition_variable idle_cv_;
+
+    std::atomic<uint64_t> callbacks_;
+    std::atomic<uint64_t> total_delay_ns_;
+    std::atomic<uint64_t> max_delay_ns_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -11,26 +11,56 @@
 
 #include <memory>
 
+#include "ClientEventLoop.h"
 #include "Macros.h"
 #include "SocketClient.h"
+#include "UringSocketClient.h"
 #include "libsercli/ClientBuilder.h"
 
 namespace nkhlab {
 namespace libsercli {
 
-IClientPtr CreateUnixClient(const char* socket_path)
+IClientPtr CreateUnixClient(const char* socket_path, const ClientConfig& config)
 {
 #ifdef __linux__
-    return std::make_unique<SocketClient<UnixSocket>>(socket_path);
+    if (config.backend == Backend::kIoUring)
+    {
+        return std::make_unique<UringSocketClient<UnixSocket>>(config, socket_path);
+    }
+    return std::make_unique<SocketClient<UnixSocket>>(config, socket_path);
 #else
     UNUSED(socket_path);
+    UNUSED(config);
     return nullptr;
 #endif
 }
 
-IClientPtr CreateInetClient(const char* address, int port)
+IClientPtr CreateInetClient(const char* address, int port, const ClientConfig& config)
 {
-    return std::make_unique<SocketClient<InetSocket>>(address, port);
+#ifdef __linux__
+    if (config.backend == Backend::kIoUring)
+    {
+        return std::make_unique<UringSocketClient<InetSocket>>(config, address, port);
+    }
+#endif
+    return std::make_unique<SocketClient<InetSocket>>(config, address, port);
+}
+
+IClientEventLoopPtr
+CreateClientEventLoop(size_t threads, size_t max_events, const ThreadConfig& thread_config)
+{
+#ifdef __linux__
+    auto event_loop = std::make_shared<ClientEventLoop>(threads, max_events, thread_config);
+
+    if (!event_loop->Start()) return nullptr;
+
+    return event_loop;
+#else
+    UNUSED(threads);
+    UNUSED(max_events);
+    UNUSED(thread_config);
+    return nullptr;
+#endif
 }
 
 } // namespace libsercli
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "ClientEventLoop.h"
+
+#include <algorithm>
+
+#include "ThreadPlacement.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+ClientEventLoop::ClientEventLoop(
+    size_t threads,
+    size_t max_events,
+    const ThreadConfig& thread_config)
+    : thread_config_{thread_config}
+    , next_reactor_{0}
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+        reactors_.emplace_back(std::make_unique<Reactor>(max_events));
+}
+
+ClientEventLoop::~ClientEventLoop()
+{
+    for (auto& reactor : reactors_) reactor->Stop();
+}
+
+bool ClientEventLoop::Start()
+{
+    for (size_t i = 0; i < reactors_.size(); ++i)
+    {
+        if (!reactors_[i]->Start(GetThreadPlacement(thread_config_, "sercli-loop", i)))
+            return false;
+    }
+
+    return true;
+}
+
+size_t ClientEventLoop::GetThreadCount() const
+{
+    return reactors_.size();
+}
+
+Reactor* ClientEventLoop::NextReactor()
+{
+    return reactors_[next_reactor_++ % reactors_.size()].get();
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "libsercli/IClientEventLoop.h"
+#include "libsercli/ThreadConfig.h"
+
+#include "Reactor.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Reactors shared by SocketClient instances, each client is served by one of them
+//
+class ClientEventLoop : public IClientEventLoop
+{
+public:
+    ClientEventLoop(size_t threads, size_t max_events, const ThreadConfig& thread_config);
+    ~ClientEventLoop();
+
+    bool Start();
+
+    size_t GetThreadCount() const override;
+
+    // Reactor for the next client, round-robin
+    Reactor* NextReactor();
+
+private:
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    const ThreadConfig thread_config_;
+    std::atomic_size_t next_reactor_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
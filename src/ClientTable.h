@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "libsercli/IServer.h"
+
+#include "SmartSocket.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Server side clients in a flat table indexed by socket, lookups take no table wide lock.
+// Slots live in pages allocated on first use and never move.
+// A ClientId carries the generation of its slot in the high 32 bits, so once a socket is
+// reused the old ID doesn't find the new client.
+// Adding and removing the same socket has to be serialized by the caller (the socket is only
+// closed after it is removed), other calls are thread safe.
+//
+// Not lock-free: a slot's shared_ptr goes through std::atomic_load/store/exchange, which
+// libstdc++ implements with a small pool of global mutexes picked by address. Each access
+// locks one of them only for a pointer copy, but unrelated slots may share one.
+// Lookups and ForEach() copy the shared_ptr they return, one atomic reference count update
+// each. The epoll read path takes no lookup at all, its client comes with the epoll event.
+//
+template <class T>
+class ClientTable
+{
+public:
+    using Ptr = std::shared_ptr<T>;
+
+    ClientTable()
+        : pages_{new std::atomic<Page*>[kPageCount]()}
+        , size_{0}
+        , count_{0}
+    {
+    }
+
+    ~ClientTable()
+    {
+        for (size_t i = 0; i < kPageCount; ++i) delete pages_[i].load();
+    }
+
+    ClientTable(const ClientTable&) = delete;
+    ClientTable& operator=(const ClientTable&) = delete;
+
+    //
+    // make(ClientId) creates the client, nullptr when the socket is out of range or limit
+    // clients are in the table already (0 for no limit)
+    //
+    template <class Make>
+    Ptr Add(SOCKET socket, Make make, size_t limit = 0)
+    {
+        size_t count = count_.load();
+
+        do
+        {
+            if (limit > 0 && count >= limit) return nullptr;
+        } while (!count_.compare_exchange_weak(count, count + 1));
+
+        Slot* slot = GetSlot(socket, true);
+        if (!slot)
+        {
+            --count_;
+            return nullptr;
+        }
+
+        // The first client on a socket gets an ID equal to the socket
+        ClientId generation = slot->generation.fetch_add(1);
+        Ptr client = make((generation << 32) | static_cast<uint32_t>(socket));
+
+        std::atomic_store(&slot->client, client);
+
+        size_t size = size_.load();
+        size_t index = static_cast<size_t>(socket);
+        while (size <= index && !size_.compare_exchange_weak(size, index + 1))
+        {
+        }
+
+        return client;
+    }
+
+    Ptr Remove(SOCKET socket)
+    {
+        Slot* slot = GetSlot(socket, false);
+        Ptr client = slot ? std::atomic_exchange(&slot->client, Ptr()) : nullptr;
+
+        if (client) --count_;
+
+        return client;
+    }
+
+    size_t GetCount() const
+    {
+        return count_.load();
+    }
+
+    Ptr Find(ClientId id) const
+    {
+        Ptr client = FindBySocket(static_cast<SOCKET>(id & 0xFFFFFFFF));
+
+        return client && client->GetClientId() == id ? client : nullptr;
+    }
+
+    Ptr FindBySocket(SOCKET socket) const
+    {
+        const Slot* slot = const_cast<ClientTable*>(this)->GetSlot(socket, false);
+
+        return slot ? std::atomic_load(&slot->client) : nullptr;
+    }
+
+    //
+    // Visits a snapshot of every slot, clients added meanwhile may be missed
+    //
+    template <class F>
+    void ForEach(F f) const
+    {
+        size_t size = size_.load();
+
+        for (size_t page = 0; page * kPageSize < size; ++page)
+        {
+            const Page* slots = pages_[page].load(std::memory_order_acquire);
+            if (!slots) continue;
+
+            for (auto& slot : *slots)
+            {
+                Ptr client = std::atomic_load(&slot.client);
+                if (client) f(client);
+            }
+        }
+    }
+
+    //
+    // Removes every client, f gets each of them
+    //
+    template <class F>
+    void Clear(F f)
+    {
+        size_t size = size_.load();
+
+        for (size_t page = 0; page * kPageSize < size; ++page)
+        {
+            Page* slots = pages_[page].load(std::memory_order_acquire);
+            if (!slots) continue;
+
+            for (auto& slot : *slots)
+            {
+                Ptr client = std::atomic_exchange(&slot.client, Ptr());
+                if (!client) continue;
+
+                --count_;
+                f(client);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<ClientId> generation{0};
+        Ptr client;
+    };
+
+    static constexpr size_t kPageSize = 1024;
+    static constexpr size_t kPageCount = 4096; // sockets up to 4M
+
+    using Page = std::array<Slot, kPageSize>;
+
+    Slot* GetSlot(SOCKET socket, bool create)
+    {
+        size_t index = static_cast<size_t>(socket);
+        if (index >= kPageSize * kPageCount) return nullptr;
+
+        auto& page = pages_[index / kPageSize];
+        Page* slots = page.load(std::memory_order_acquire);
+
+        if (!slots && create)
+        {
+            auto fresh = std::make_unique<Page>();
+
+            // Another thread may have won, slots is updated to its page then
+            if (page.compare_exchange_strong(slots, fresh.get(), std::memory_order_acq_rel))
+                slots = fresh.release();
+        }
+
+        return slots ? &(*slots)[index % kPageSize] : nullptr;
+    }
+
+    std::unique_ptr<std::atomic<Page*>[]> pages_;
+    std::atomic_size_t size_; // past the highest socket ever added
+    std::atomic_size_t count_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Stops accepting while max_connections clients are served, so connections over the limit wait
+// in the listen backlog instead of being accepted and closed. Thread safe.
+//
+class ConnectionLimit
+{
+public:
+    // set_accepting is called with the new state, under the limit's lock
+    ConnectionLimit(size_t max_connections, std::function<void(bool accepting)> set_accepting)
+        : max_connections_{max_connections}
+        , set_accepting_{std::move(set_accepting)}
+        , reached_{false}
+    {
+    }
+
+    //
+    // To be called after every client added or removed. The count is read under the lock,
+    // so the last update sees the last change. Returns true when accepting just paused.
+    //
+    template <class Table>
+    bool Update(const Table& clients)
+    {
+        if (max_connections_ == 0) return false;
+
+        std::lock_guard<std::mutex> lk(m_);
+
+        bool reached = clients.GetCount() >= max_connections_;
+        if (reached == reached_) return false;
+
+        reached_ = reached;
+        set_accepting_(!reached);
+
+        return reached;
+    }
+
+    bool IsReached()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return reached_;
+    }
+
+private:
+    const size_t max_connections_; // 0 for no limit
+    const std::function<void(bool accepting)> set_accepting_;
+    std::mutex m_;
+    bool reached_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
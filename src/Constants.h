@@ -11,10 +11,17 @@
 
 #pragma once
 
+#include <cstddef>
+
 namespace nkhlab {
 namespace libsercli {
 
-constexpr size_t kDataBufferSize = 1024;
+// Accepting pauses this long once the process runs out of file descriptors
+constexpr int kAcceptRetryDelay_ms = 100;
+// Buffers gathered into one sendmsg(), the rest waits for the next round
+constexpr size_t kMaxIov = 64;
+// Callbacks a strand runs before the other strands of its worker get their turn
+constexpr size_t kStrandBatch = 16;
 
 }
 } // namespace nkhlab
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "FlushTimer.h"
+
+#include <sys/timerfd.h>
+
+#include <algorithm>
+
+#include "Macros.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+FlushTimer::FlushTimer(std::chrono::microseconds delay, std::function<void(SOCKET)> flush)
+    : timer_fd_{-1}
+    , delay_{std::max(delay, std::chrono::microseconds(1))} // a zero timeout disarms a timerfd
+    , flush_{std::move(flush)}
+{
+}
+
+FlushTimer::~FlushTimer()
+{
+    Close();
+}
+
+bool FlushTimer::Open()
+{
+    if (timer_fd_ != -1) return true;
+
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    std::lock_guard<std::mutex> lk(scheduled_mtx_);
+    scheduled_.clear();
+
+    return timer_fd_ != -1;
+}
+
+void FlushTimer::Close()
+{
+    if (timer_fd_ != -1)
+    {
+        close(timer_fd_);
+        timer_fd_ = -1;
+    }
+}
+
+int FlushTimer::GetFd() const
+{
+    return timer_fd_;
+}
+
+void FlushTimer::Schedule(SOCKET socket)
+{
+    std::lock_guard<std::mutex> lk(scheduled_mtx_);
+
+    if (scheduled_.empty())
+    {
+        itimerspec spec{};
+        spec.it_value.tv_sec = static_cast<time_t>(delay_.count() / 1000000);
+        spec.it_value.tv_nsec = static_cast<long>(delay_.count() % 1000000 * 1000);
+
+        timerfd_settime(timer_fd_, 0, &spec, nullptr);
+    }
+
+    scheduled_.push_back(socket);
+}
+
+void FlushTimer::HandleEvents(uint32_t events)
+{
+    UNUSED(events);
+
+    uint64_t expirations;
+    if (read(timer_fd_, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+
+    {
+        std::lock_guard<std::mutex> lk(scheduled_mtx_);
+        flushing_.swap(scheduled_);
+    }
+
+    for (SOCKET socket : flushing_) flush_(socket);
+
+    flushing_.clear();
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "Reactor.h"
+#include "SmartSocket.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Enforces the latency budget of write coalescing for the connections of one reactor.
+// A timerfd armed by the first connection scheduled since it last fired,
+// on expiry flush is called for every connection scheduled meanwhile.
+// Servers also use it to retry accepting after a delay.
+//
+class FlushTimer : public IReactorHandler
+{
+public:
+    FlushTimer(std::chrono::microseconds delay, std::function<void(SOCKET)> flush);
+    ~FlushTimer();
+
+    FlushTimer(const FlushTimer&) = delete;
+    FlushTimer& operator=(const FlushTimer&) = delete;
+
+    bool Open();
+    void Close();
+
+    // To be registered for EPOLLIN
+    int GetFd() const;
+
+    // Thread safe
+    void Schedule(SOCKET socket);
+
+    void HandleEvents(uint32_t events) override;
+
+private:
+    int timer_fd_;
+    const std::chrono::microseconds delay_;
+    const std::function<void(SOCKET)> flush_;
+    std::vector<SOCKET> scheduled_;
+    std::vector<SOCKET> flushing_; // only touched by the reactor thread
+    std::mutex scheduled_mtx_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
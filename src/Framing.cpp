@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#include "Framing.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// FrameDecoder
+//
+
+FrameDecoder::FrameDecoder(BufferPool* pool, size_t max_frame_size)
+    : parser_{max_frame_size, Reassembly(pool)}
+{
+}
+
+FrameDecoder::Reassembly::Reassembly(BufferPool* pool)
+    : pool_{pool}
+    , frame_filled_{0}
+{
+}
+
+void FrameDecoder::Reassembly::Begin(size_t frame_size)
+{
+    frame_ = frame_size <= pool_->GetBufferSize()
+                 ? pool_->Acquire()
+                 : BufferPool::Allocate(frame_size, pool_->GetResource());
+    frame_filled_ = 0;
+}
+
+void FrameDecoder::Reassembly::Append(const uint8_t* data, size_t size)
+{
+    memcpy(BufferPool::MutableData(frame_) + frame_filled_, data, size);
+    frame_filled_ += size;
+}
+
+Buffer FrameDecoder::Reassembly::Take()
+{
+    BufferPool::SetSize(frame_, frame_filled_);
+    return std::move(frame_);
+}
+
+//
+// OutgoingFrame
+//
+
+OutgoingFrame::OutgoingFrame(const DataView* data, size_t count, size_t max_frame_size)
+    : data_{data}
+    , count_{count}
+    , valid_{true}
+    , framed_{max_frame_size > 0}
+{
+    if (!framed_) return;
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) size += data[i].size();
+
+    if (!EncodeFrameHeader(size, max_frame_size, header_))
+    {
+        valid_ = false;
+        return;
+    }
+
+    if (count >= kInlineParts) parts_.resize(count + 1);
+
+    DataView* parts = parts_.empty() ? inline_parts_ : parts_.data();
+
+    parts[0] = DataView(header_, kFrameHeaderSize);
+    std::copy(data, data + count, parts + 1);
+
+    data_ = parts;
+    count_ = count + 1;
+}
+
+SendCompletedCb OutgoingFrame::KeepHeader(SendCompletedCb completed_cb)
+{
+    if (!framed_) return completed_cb;
+
+    auto header = std::make_shared<std::array<uint8_t, kFrameHeaderSize>>();
+
+    DataView* parts = parts_.empty() ? inline_parts_ : parts_.data();
+
+    std::copy(header_, header_ + kFrameHeaderSize, header->begin());
+    parts[0] = DataView(header->data(), kFrameHeaderSize);
+
+    return [header, completed_cb](bool sent) {
+        if (completed_cb) completed_cb(sent);
+    };
+}
+
+SharedPayload MakeSharedFrame(DataView data, size_t max_frame_size)
+{
+    OutgoingFrame frame(&data, 1, max_frame_size);
+    if (!frame) return nullptr;
+
+    auto payload = std::make_shared<std::vector<uint8_t>>();
+    payload->reserve(data.size() + kFrameHeaderSize);
+
+    for (size_t i = 0; i < frame.count(); ++i)
+        payload->insert(payload->end(), frame.data()[i].begin(), frame.data()[i].end());
+
+    return payload;
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "libsercli/Buffer.h"
+#include "libsercli/Callbacks.h"
+#include "libsercli/DataView.h"
+#include "libsercli/FrameParser.h"
+
+#include "BufferPool.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Reassembles the frames of one connection from received chunks.
+// A frame that lies in one chunk is handed out as a slice of it, only frames spread over
+// several chunks are copied together, into a buffer of the pool.
+//
+class FrameDecoder
+{
+public:
+    FrameDecoder(BufferPool* pool, size_t max_frame_size);
+
+    //
+    // Returns false when a frame over the limit comes in, the stream can't be followed then.
+    // frame_cb returns false to stop after its frame, e.g. reading was paused from it: the rest
+    // of the chunk is put in unread then, to be fed again later, and unread is left empty
+    // otherwise. A template, so the callback of every received chunk isn't wrapped into
+    // a std::function.
+    //
+    template <typename FrameCb>
+    bool Feed(const Buffer& data, FrameCb&& frame_cb, Buffer* unread);
+
+private:
+    class Reassembly
+    {
+    public:
+        explicit Reassembly(BufferPool* pool);
+
+        void Begin(size_t frame_size);
+        void Append(const uint8_t* data, size_t size);
+
+        // The completed frame, moved out
+        Buffer Take();
+
+    private:
+        BufferPool* pool_;
+        Buffer frame_;
+        size_t frame_filled_;
+    };
+
+    FrameParser<Reassembly> parser_;
+};
+
+template <typename FrameCb>
+bool FrameDecoder::Feed(const Buffer& data, FrameCb&& frame_cb, Buffer* unread)
+{
+    size_t consumed = 0;
+
+    bool ok = parser_.Feed(
+        data.data(),
+        data.size(),
+        [&](size_t pos, size_t size) { return frame_cb(BufferPool::Slice(data, pos, size)); },
+        [&](Reassembly& reassembly) { return frame_cb(reassembly.Take()); },
+        &consumed);
+
+    if (!ok) return false;
+
+    if (consumed < data.size())
+        *unread = BufferPool::Slice(data, consumed, data.size() - consumed);
+    else
+        unread->Reset();
+
+    return true;
+}
+
+//
+// Parts of an outgoing frame: the length header followed by the payload,
+// so both go out with one system call. Passes the payload through with framing off.
+//
+class OutgoingFrame
+{
+public:
+    // max_frame_size 0 means framing is off
+    OutgoingFrame(const DataView* data, size_t count, size_t max_frame_size);
+
+    OutgoingFrame(const OutgoingFrame&) = delete;
+    OutgoingFrame& operator=(const OutgoingFrame&) = delete;
+
+    // false when the payload is over the limit
+    explicit operator bool() const { return valid_; }
+
+    const DataView* data() const { return data_; }
+    size_t count() const { return count_; }
+
+    //
+    // Zero-copy sends read the header after the call returns: moves it to the heap,
+    // the returned callback keeps it alive until the send completes
+    //
+    SendCompletedCb KeepHeader(SendCompletedCb completed_cb);
+
+private:
+    static constexpr size_t kInlineParts = 8;
+
+    uint8_t header_[kFrameHeaderSize];
+    DataView inline_parts_[kInlineParts];
+    std::vector<DataView> parts_; // payloads of more parts than fit inline
+    const DataView* data_;
+    size_t count_;
+    bool valid_;
+    bool framed_;
+};
+
+//
+// Payload shared by the sends of many connections, e.g. a broadcast
+//
+using SharedPayload = std::shared_ptr<const std::vector<uint8_t>>;
+
+// data as one frame in a single block, as is with framing off. nullptr when over the limit.
+SharedPayload MakeSharedFrame(DataView data, size_t max_frame_size);
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "IoUring.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace nkhlab {
+namespace libsercli {
+
+namespace {
+
+int Setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int Enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int Register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <class T>
+T* At(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring()
+    : fd_{-1}
+    , sq_ring_{MAP_FAILED}
+    , sq_ring_size_{0}
+    , cq_ring_{MAP_FAILED}
+    , cq_ring_size_{0}
+    , sqes_{nullptr}
+    , sqes_size_{0}
+    , sq_head_{nullptr}
+    , sq_tail_{nullptr}
+    , sq_mask_{0}
+    , sq_entries_{0}
+    , sqe_head_{0}
+    , sqe_tail_{0}
+    , cq_head_{nullptr}
+    , cq_tail_{nullptr}
+    , cq_mask_{0}
+    , cqes_{nullptr}
+    , buf_ring_{nullptr}
+    , buf_ring_size_{0}
+    , buf_mask_{0}
+    , buf_tail_{0}
+{
+}
+
+IoUring::~IoUring()
+{
+    Close();
+}
+
+bool IoUring::Init(unsigned entries)
+{
+    io_uring_params params{};
+
+    // Completions are processed only by the submitting thread, let it run their work too
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    fd_ = Setup(entries, &params);
+
+    if (fd_ == -1 && errno == EINVAL)
+    {
+        // Kernel older than 6.1
+        params = {};
+        fd_ = Setup(entries, &params);
+    }
+
+    if (fd_ == -1) return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    sq_ring_ = mmap(
+        nullptr,
+        sq_ring_size_,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        fd_,
+        IORING_OFF_SQ_RING);
+
+    if (single_mmap)
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else if (sq_ring_ != MAP_FAILED)
+    {
+        cq_ring_ = mmap(
+            nullptr,
+            cq_ring_size_,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd_,
+            IORING_OFF_CQ_RING);
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    void* sqes = mmap(
+        nullptr,
+        sqes_size_,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        fd_,
+        IORING_OFF_SQES);
+
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size_);
+        Close();
+        return false;
+    }
+
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = At<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = At<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *At<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sqe_head_ = sqe_tail_ = *sq_tail_;
+
+    // Entries are always submitted in order, so the indirection array is an identity
+    unsigned* sq_array = At<unsigned>(sq_ring_, params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) sq_array[i] = i;
+
+    cq_head_ = At<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = At<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *At<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = At<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+    return true;
+}
+
+void IoUring::Close()
+{
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+    if (fd_ != -1) close(fd_);
+    // Unregistered with the ring, the kernel pins the pages as long as it uses them
+    if (buf_ring_) munmap(buf_ring_, buf_ring_size_);
+
+    fd_ = -1;
+    sq_ring_ = cq_ring_ = MAP_FAILED;
+    sqes_ = nullptr;
+    buf_ring_ = nullptr;
+}
+
+bool IoUring::InitBufferRing(unsigned entries, uint16_t group)
+{
+    buf_ring_size_ = entries * sizeof(io_uring_buf);
+
+    // The kernel wants it page aligned, and zeroed the tail starts at 0
+    void* ring = mmap(
+        nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ring == MAP_FAILED) return false;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+
+    if (Register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+        munmap(ring, buf_ring_size_);
+        return false;
+    }
+
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    buf_mask_ = entries - 1;
+    buf_tail_ = 0;
+
+    return true;
+}
+
+void IoUring::ProvideBuffer(void* data, uint32_t size, uint16_t id)
+{
+    //
+    // Not through buf_ring_->bufs: compiled as C++, the empty struct in front of that flexible
+    // array takes a byte and moves it 8 bytes off the entries the kernel reads
+    //
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(buf_ring_) + (buf_tail_ & buf_mask_);
+
+    // Field by field: the tail shares its place with resv of the first entry
+    buf->addr = reinterpret_cast<uint64_t>(data);
+    buf->len = size;
+    buf->bid = id;
+
+    ++buf_tail_;
+}
+
+int IoUring::GetFd() const
+{
+    return fd_;
+}
+
+io_uring_sqe* IoUring::GetSqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    if (sqe_tail_ - head >= sq_entries_) return nullptr;
+
+    io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::SubmitAndWait(unsigned wait_nr)
+{
+    return Submit(wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+int IoUring::SubmitAndPoll()
+{
+    return Submit(0, IORING_ENTER_GETEVENTS);
+}
+
+int IoUring::Submit(unsigned wait_nr, unsigned flags)
+{
+    unsigned to_submit = sqe_tail_ - sqe_head_;
+
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    if (buf_ring_) __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+
+    int ret = Enter(fd_, to_submit, wait_nr, flags);
+    if (ret == -1) return -errno;
+
+    sqe_head_ += static_cast<unsigned>(ret);
+    return ret;
+}
+
+io_uring_cqe* IoUring::PeekCqe()
+{
+    unsigned head = *cq_head_;
+
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return nullptr;
+
+    return &cqes_[head & cq_mask_];
+}
+
+void IoUring::SeenCqe()
+{
+    __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
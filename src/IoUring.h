@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Minimal io_uring instance on top of the raw system calls.
+// Not thread safe, all calls are expected from the thread that called Init().
+//
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool Init(unsigned entries);
+    void Close();
+
+    int GetFd() const;
+
+    // Zeroed entry, nullptr when the submission queue is full
+    io_uring_sqe* GetSqe();
+
+    // Submits all prepared entries and waits for at least wait_nr completions,
+    // returns the number submitted or -errno
+    int SubmitAndWait(unsigned wait_nr);
+    //
+    // Submits all prepared entries and posts the completions that are ready without waiting,
+    // with IORING_SETUP_DEFER_TASKRUN they show up only when asked for.
+    // Returns the number submitted or -errno.
+    //
+    int SubmitAndPoll();
+
+    //
+    // Registers a ring of entries (a power of 2, up to 32768) buffers the kernel picks from for
+    // requests with IOSQE_BUFFER_SELECT and this group, false if the kernel refuses it
+    //
+    bool InitBufferRing(unsigned entries, uint16_t group);
+    // Adds a buffer to the ring, the kernel sees it from the next submission on
+    void ProvideBuffer(void* data, uint32_t size, uint16_t id);
+
+    // nullptr when the completion queue is empty
+    io_uring_cqe* PeekCqe();
+    void SeenCqe();
+
+private:
+    int Submit(unsigned wait_nr, unsigned flags);
+
+    int fd_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned sqe_head_; // prepared entries not submitted yet are [sqe_head_, sqe_tail_)
+    unsigned sqe_tail_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    io_uring_buf_ring* buf_ring_;
+    size_t buf_ring_size_;
+    unsigned buf_mask_;
+    uint16_t buf_tail_; // added buffers not seen by the kernel yet are up to buf_tail_
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
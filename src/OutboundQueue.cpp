@@ -0,0 +1,614 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "OutboundQueue.h"
+
+#include <linux/errqueue.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "Constants.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+OutboundQueue::OutboundQueue(
+    SOCKET socket,
+    size_t coalesce_bytes,
+    std::function<void()> schedule_flush,
+    MemoryResource* resource)
+    : socket_{socket}
+    , coalesce_bytes_{coalesce_bytes}
+    , schedule_flush_{std::move(schedule_flush)}
+    , allocator_{resource}
+    , messages_{allocator_}
+    , pending_{false}
+    , blocked_{false}
+    , closed_{false}
+    , queued_bytes_{0}
+    , zero_copy_min_bytes_{0}
+    , in_flight_{allocator_}
+    , next_id_{0}
+    , released_id_{0}
+    , released_ahead_{allocator_}
+{
+}
+
+bool OutboundQueue::Send(const DataView* data, size_t count, SendCompletedCb completed_cb)
+{
+    return Send(data, count, std::move(completed_cb), false);
+}
+
+bool OutboundQueue::SendBorrowed(const DataView* data, size_t count, SendCompletedCb completed_cb)
+{
+    return Send(data, count, std::move(completed_cb), true);
+}
+
+bool OutboundQueue::Send(
+    const DataView* data,
+    size_t count,
+    SendCompletedCb completed_cb,
+    bool borrowed)
+{
+    std::vector<SendCompletedCb> completed_cbs;
+    bool ret = true;
+    bool sent = false;
+    bool first_held = false;
+    bool writable_changed = false;
+    bool writable = true;
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        if (closed_) return false;
+
+        pending_ = true;
+
+        size_t size = 0;
+        for (size_t i = 0; i < count; ++i) size += data[i].size();
+
+        if (!blocked_ && size < coalesce_bytes_)
+        {
+            // Held back until the byte budget is spent, a broken socket fails it on Close()
+            first_held = messages_.empty();
+
+            if (borrowed)
+                QueueBorrowed(data, count, 0, std::move(completed_cb), false);
+            else
+                Queue(data, count, 0, std::move(completed_cb));
+
+            if (queued_bytes_ >= coalesce_bytes_)
+            {
+                first_held = false;
+                WriteQueued(completed_cbs);
+            }
+        }
+        else
+        {
+            // Held back sends go first to keep the order
+            if (!blocked_ && !messages_.empty()) ret = WriteQueued(completed_cbs);
+
+            if (ret && !blocked_)
+            {
+                // Fast path: nothing queued, so nothing to keep the order with
+                ssize_t bytes_written = Write(data, count);
+
+                if (bytes_written == -1)
+                {
+                    ret = false;
+                }
+                else if (static_cast<size_t>(bytes_written) == size)
+                {
+                    sent = true;
+                }
+                else
+                {
+                    // Whatever the socket did not take goes to the queue
+                    size_t skip = static_cast<size_t>(bytes_written);
+
+                    if (borrowed)
+                        QueueBorrowed(data, count, skip, std::move(completed_cb), false);
+                    else
+                        Queue(data, count, skip, std::move(completed_cb));
+
+                    blocked_ = true;
+                }
+            }
+            else if (ret)
+            {
+                if (borrowed)
+                    QueueBorrowed(data, count, 0, std::move(completed_cb), false);
+                else
+                    Queue(data, count, 0, std::move(completed_cb));
+            }
+        }
+
+        if (messages_.empty()) pending_ = false;
+
+        writable_changed = watermarks_.Update(queued_bytes_);
+        writable = watermarks_.IsWritable();
+    }
+
+    for (auto& cb : completed_cbs) cb(true);
+
+    if (writable_changed && writable_cb_) writable_cb_(writable);
+    if (sent && completed_cb) completed_cb(true);
+    if (first_held && schedule_flush_) schedule_flush_();
+
+    return ret;
+}
+
+bool OutboundQueue::SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) size += data[i].size();
+
+    // Pinning pages costs more than copying a small payload
+    size_t min_bytes = zero_copy_min_bytes_;
+    if (min_bytes == 0 || size < min_bytes) return Send(data, count, std::move(completed_cb));
+
+    std::vector<SendCompletedCb> completed_cbs;
+    bool ret = true;
+    bool writable_changed = false;
+    bool writable = true;
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        if (closed_) return false;
+
+        pending_ = true;
+
+        // Held back sends go first to keep the order
+        if (!blocked_ && !messages_.empty()) ret = WriteQueued(completed_cbs);
+
+        if (ret && !blocked_)
+        {
+            ssize_t bytes_written = Write(data, count, MSG_ZEROCOPY);
+
+            if (bytes_written == -1)
+            {
+                ret = false;
+            }
+            else if (static_cast<size_t>(bytes_written) == size)
+            {
+                Complete(true, std::move(completed_cb), completed_cbs);
+            }
+            else
+            {
+                QueueBorrowed(
+                    data, count, static_cast<size_t>(bytes_written), std::move(completed_cb), true);
+                blocked_ = true;
+            }
+        }
+        else if (ret)
+        {
+            QueueBorrowed(data, count, 0, std::move(completed_cb), true);
+        }
+
+        if (messages_.empty()) pending_ = false;
+
+        writable_changed = watermarks_.Update(queued_bytes_);
+        writable = watermarks_.IsWritable();
+    }
+
+    for (auto& cb : completed_cbs) cb(true);
+
+    if (writable_changed && writable_cb_) writable_cb_(writable);
+
+    return ret;
+}
+
+void OutboundQueue::EnableZeroCopy(size_t min_bytes)
+{
+    if (min_bytes == 0) return;
+
+    int on = 1;
+    if (setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0)
+        zero_copy_min_bytes_ = min_bytes;
+}
+
+void OutboundQueue::SetWatermarks(
+    const WatermarkConfig& config,
+    std::function<void(bool writable)> writable_cb)
+{
+    watermarks_ = Watermarks(config);
+    writable_cb_ = std::move(writable_cb);
+}
+
+bool OutboundQueue::Flush()
+{
+    if (!pending_) return true;
+
+    std::vector<SendCompletedCb> completed_cbs;
+    bool ret = true;
+    bool writable_changed = false;
+    bool writable = true;
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        ret = WriteQueued(completed_cbs);
+
+        if (messages_.empty()) pending_ = false;
+
+        writable_changed = watermarks_.Update(queued_bytes_);
+        writable = watermarks_.IsWritable();
+    }
+
+    for (auto& completed_cb : completed_cbs) completed_cb(true);
+
+    if (writable_changed && writable_cb_) writable_cb_(writable);
+
+    return ret;
+}
+
+void OutboundQueue::ReapZeroCopy()
+{
+    std::vector<SendCompletedCb> completed_cbs;
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        for (;;)
+        {
+            char control[CMSG_SPACE(sizeof(sock_extended_err))];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+            {
+                if (errno == EINTR) continue;
+                break; // EAGAIN: nothing more reported
+            }
+
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                    !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                    continue;
+
+                auto err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+
+                if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+                // The kernel had to copy anyway (e.g. loopback), pinning pages only costs then
+                if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) zero_copy_min_bytes_ = 0;
+
+                ReleaseZeroCopy(err->ee_info, err->ee_data);
+            }
+        }
+
+        while (!in_flight_.empty() &&
+               static_cast<int32_t>(in_flight_.front().last_id - released_id_) < 0)
+        {
+            completed_cbs.push_back(std::move(in_flight_.front().completed_cb));
+            in_flight_.pop_front();
+        }
+    }
+
+    for (auto& completed_cb : completed_cbs) completed_cb(true);
+}
+
+void OutboundQueue::Close()
+{
+    Messages messages(allocator_);
+    InFlights in_flight(allocator_);
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        closed_ = true;
+        pending_ = false;
+        blocked_ = false;
+        queued_bytes_ = 0;
+        watermarks_.Reset(); // nothing is reported for a closed connection
+        messages.swap(messages_);
+        in_flight.swap(in_flight_);
+    }
+
+    for (auto& message : in_flight)
+    {
+        if (message.completed_cb) message.completed_cb(false);
+    }
+
+    for (auto& message : messages)
+    {
+        if (message.completed_cb) message.completed_cb(false);
+    }
+}
+
+void OutboundQueue::Open()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    closed_ = false;
+}
+
+size_t OutboundQueue::GetQueuedBytes()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    return queued_bytes_;
+}
+
+void OutboundQueue::Queue(
+    const DataView* data,
+    size_t count,
+    size_t skip,
+    SendCompletedCb completed_cb)
+{
+    // One contiguous message, so its parts never interleave with other sends
+    Message message{Bytes(allocator_), DataView(), 0, false, std::move(completed_cb)};
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) size += data[i].size();
+
+    message.data.reserve(size - skip);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* begin = data[i].data();
+        size_t len = data[i].size();
+
+        if (skip >= len)
+        {
+            skip -= len;
+            continue;
+        }
+
+        message.data.insert(message.data.end(), begin + skip, begin + len);
+        skip = 0;
+    }
+
+    queued_bytes_ += message.data.size();
+    messages_.push_back(std::move(message));
+    messages_.back().view = DataView(messages_.back().data.data(), messages_.back().data.size());
+}
+
+bool OutboundQueue::IsBlocked()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    return blocked_;
+}
+
+bool OutboundQueue::IsWritable()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    return watermarks_.IsWritable();
+}
+
+void OutboundQueue::QueueBorrowed(
+    const DataView* data,
+    size_t count,
+    size_t skip,
+    SendCompletedCb completed_cb,
+    bool zero_copy)
+{
+    // Queued back to back under the lock, so the parts never interleave with other sends either
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t len = data[i].size();
+
+        if (skip >= len && i + 1 < count)
+        {
+            skip -= len;
+            continue;
+        }
+
+        size_t offset = std::min(skip, len);
+        skip -= offset;
+
+        Message message{Bytes(allocator_), data[i], offset, zero_copy, nullptr};
+        if (i + 1 == count) message.completed_cb = std::move(completed_cb);
+
+        queued_bytes_ += len - offset;
+        messages_.push_back(std::move(message));
+    }
+}
+
+void OutboundQueue::Complete(
+    bool zero_copy,
+    SendCompletedCb completed_cb,
+    std::vector<SendCompletedCb>& completed_cbs)
+{
+    if (!completed_cb) return;
+
+    // Released already if no zero-copy sendmsg() carried it, e.g. after a fallback to a copy
+    uint32_t last_id = next_id_ - 1;
+
+    if (zero_copy && static_cast<int32_t>(last_id - released_id_) >= 0)
+        in_flight_.push_back(InFlight{last_id, std::move(completed_cb)});
+    else
+        completed_cbs.push_back(std::move(completed_cb));
+}
+
+void OutboundQueue::ReleaseZeroCopy(uint32_t first_id, uint32_t last_id)
+{
+    if (first_id != released_id_)
+    {
+        // Ordered is the common case, but retransmits may reorder the reports
+        released_ahead_[first_id] = last_id;
+        return;
+    }
+
+    released_id_ = last_id + 1;
+
+    for (auto it = released_ahead_.find(released_id_); it != released_ahead_.end();
+         it = released_ahead_.find(released_id_))
+    {
+        released_id_ = it->second + 1;
+        released_ahead_.erase(it);
+    }
+}
+
+bool OutboundQueue::WriteQueued(std::vector<SendCompletedCb>& completed_cbs)
+{
+    bool ret = true;
+
+    while (!messages_.empty())
+    {
+        // A batch is either all copies or all zero-copy
+        bool zero_copy = messages_.front().zero_copy;
+
+        iovec iov[kMaxIov];
+        size_t iov_count = 0;
+        size_t size = 0;
+
+        for (size_t i = 0; i < messages_.size() && iov_count < kMaxIov; ++i)
+        {
+            Message& message = messages_[i];
+
+            if (message.zero_copy != zero_copy) break;
+
+            iov[iov_count].iov_base = const_cast<uint8_t*>(message.view.data()) + message.offset;
+            iov[iov_count].iov_len = message.view.size() - message.offset;
+            size += iov[iov_count].iov_len;
+            ++iov_count;
+        }
+
+        ssize_t bytes_written = Write(iov, iov_count, zero_copy ? MSG_ZEROCOPY : 0);
+
+        if (bytes_written == -1)
+        {
+            ret = false;
+            break;
+        }
+
+        size_t written = static_cast<size_t>(bytes_written);
+        queued_bytes_ -= written;
+
+        // Empty messages are done as soon as they are reached
+        for (size_t i = 0; i < iov_count; ++i)
+        {
+            Message& message = messages_.front();
+            size_t len = std::min(written, message.view.size() - message.offset);
+
+            message.offset += len;
+            written -= len;
+
+            if (message.offset < message.view.size()) break;
+
+            Complete(message.zero_copy, std::move(message.completed_cb), completed_cbs);
+            messages_.pop_front();
+        }
+
+        // EAGAIN, wait for the next EPOLLOUT
+        if (static_cast<size_t>(bytes_written) < size) break;
+    }
+
+    blocked_ = !messages_.empty();
+
+    return ret;
+}
+
+ssize_t OutboundQueue::Write(const DataView* data, size_t count, int flags)
+{
+    size_t written = 0;
+
+    for (size_t first = 0; first < count; first += kMaxIov)
+    {
+        iovec iov[kMaxIov];
+        size_t iov_count = std::min(count - first, kMaxIov);
+        size_t size = 0;
+
+        for (size_t i = 0; i < iov_count; ++i)
+        {
+            iov[i].iov_base = const_cast<uint8_t*>(data[first + i].data());
+            iov[i].iov_len = data[first + i].size();
+            size += iov[i].iov_len;
+        }
+
+        ssize_t bytes_written = Write(iov, iov_count, flags);
+
+        if (bytes_written == -1) return -1;
+
+        written += static_cast<size_t>(bytes_written);
+
+        // EAGAIN, the rest waits for EPOLLOUT
+        if (static_cast<size_t>(bytes_written) < size) break;
+    }
+
+    return static_cast<ssize_t>(written);
+}
+
+ssize_t OutboundQueue::Write(iovec* iov, size_t count, int flags)
+{
+    size_t written = 0;
+
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    while (true)
+    {
+        // Nothing left to send in empty parts, sendmsg() would return 0 as on a closed socket
+        while (msg.msg_iovlen > 0 && msg.msg_iov->iov_len == 0)
+        {
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+
+        if (msg.msg_iovlen == 0) break;
+
+        ssize_t bytes_written = sendmsg(socket_, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | flags);
+
+        if (bytes_written > 0)
+        {
+            written += static_cast<size_t>(bytes_written);
+
+            // Every zero-copy call gets the next id, the kernel reports them as ranges
+            if (flags & MSG_ZEROCOPY) ++next_id_;
+
+            // Skip what has been sent, a partially sent buffer is trimmed in place
+            size_t left = static_cast<size_t>(bytes_written);
+
+            while (msg.msg_iovlen > 0 && left >= msg.msg_iov->iov_len)
+            {
+                left -= msg.msg_iov->iov_len;
+                ++msg.msg_iov;
+                --msg.msg_iovlen;
+            }
+
+            if (msg.msg_iovlen > 0)
+            {
+                msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + left;
+                msg.msg_iov->iov_len -= left;
+            }
+        }
+        else if (bytes_written == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (bytes_written == -1 && errno == ENOBUFS && (flags & MSG_ZEROCOPY))
+        {
+            // Out of optmem or locked pages for zero-copy, copy instead
+            flags &= ~MSG_ZEROCOPY;
+        }
+        else if (bytes_written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return static_cast<ssize_t>(written);
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "libsercli/Callbacks.h"
+#include "libsercli/DataView.h"
+#include "libsercli/MemoryResource.h"
+#include "libsercli/WatermarkConfig.h"
+
+#include "ResourceAllocator.h"
+#include "SmartSocket.h"
+#include "Watermarks.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Outbound data of one non-blocking socket registered for EPOLLOUT | EPOLLET.
+// Send() writes inline while nothing is queued and queues whatever the socket did not take,
+// the reactor thread calls Flush() on EPOLLOUT to write the rest.
+// Both gather their buffers into one sendmsg() call.
+// With coalesce_bytes set, smaller sends are held back until that many bytes are queued
+// or Flush() is called, schedule_flush is called when the first one is held back.
+// SendZeroCopy() leaves large payloads in the caller's memory, the kernel reads them from there
+// and reports it on the socket error queue, ReapZeroCopy() is called on EPOLLERR to collect that.
+// SendBorrowed() leaves the data in the caller's memory too, but the kernel still copies it.
+// With watermarks set, writable_cb reports the queue crossing them, from the thread that made
+// it grow or shrink.
+// Send() may be called from any number of threads at once.
+// The queue and the copies of the data come from resource, the global heap without one.
+//
+class OutboundQueue
+{
+public:
+    explicit OutboundQueue(
+        SOCKET socket,
+        size_t coalesce_bytes = 0,
+        std::function<void()> schedule_flush = nullptr,
+        MemoryResource* resource = nullptr);
+
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    // Returns false if the queue is closed or the socket is broken, completed_cb is not called then
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb);
+
+    // data must stay valid until completed_cb is called, falls back to Send() below the threshold
+    bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb);
+
+    // data must stay valid until completed_cb is called, whatever its size it is never copied
+    bool SendBorrowed(const DataView* data, size_t count, SendCompletedCb completed_cb);
+
+    // Turns on SO_ZEROCOPY for payloads of at least min_bytes, 0 keeps it off
+    void EnableZeroCopy(size_t min_bytes);
+
+    // To be called before the first send
+    void SetWatermarks(
+        const WatermarkConfig& config,
+        std::function<void(bool writable)> writable_cb);
+
+    // Returns false if the socket is broken
+    bool Flush();
+
+    // Completes zero-copy sends the kernel is done with
+    void ReapZeroCopy();
+
+    // Fails everything still queued and refuses further sends until reopened
+    void Close();
+    void Open();
+
+    size_t GetQueuedBytes();
+
+    // The socket took less than asked, the rest waits for EPOLLOUT
+    bool IsBlocked();
+
+    bool IsWritable();
+
+private:
+    using Bytes = std::vector<uint8_t, ResourceAllocator<uint8_t>>;
+
+    struct Message
+    {
+        Bytes data;                // copy of the payload, empty for borrowed ones
+        DataView view;             // the payload itself
+        size_t offset;
+        bool zero_copy;
+        SendCompletedCb completed_cb;
+    };
+
+    // Zero-copy send waiting for the kernel to release its memory
+    struct InFlight
+    {
+        uint32_t last_id; // of the last sendmsg() that carried its data
+        SendCompletedCb completed_cb;
+    };
+
+    using Messages = std::deque<Message, ResourceAllocator<Message>>;
+    using InFlights = std::deque<InFlight, ResourceAllocator<InFlight>>;
+    using Ranges = std::map<
+        uint32_t,
+        uint32_t,
+        std::less<uint32_t>,
+        ResourceAllocator<std::pair<const uint32_t, uint32_t>>>;
+
+    // Send() and SendBorrowed()
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb, bool borrowed);
+
+    // Copies data except its first skip bytes to the end of the queue
+    void Queue(const DataView* data, size_t count, size_t skip, SendCompletedCb completed_cb);
+
+    // Same without the copy, completed_cb goes with the last part
+    void QueueBorrowed(
+        const DataView* data,
+        size_t count,
+        size_t skip,
+        SendCompletedCb completed_cb,
+        bool zero_copy);
+
+    // Reports a written message, zero-copy ones once the kernel releases their memory.
+    // messages_mtx_ must be locked.
+    void Complete(
+        bool zero_copy,
+        SendCompletedCb completed_cb,
+        std::vector<SendCompletedCb>& completed_cbs);
+
+    // Marks sendmsg() calls [first_id, last_id] released by the kernel
+    void ReleaseZeroCopy(uint32_t first_id, uint32_t last_id);
+
+    // Writes queued messages until EAGAIN, messages_mtx_ must be locked
+    bool WriteQueued(std::vector<SendCompletedCb>& completed_cbs);
+
+    // Writes data in batches of kMaxIov parts until all of it is written or EAGAIN.
+    // Returns bytes written, -1 if the socket is broken.
+    ssize_t Write(const DataView* data, size_t count, int flags = 0);
+
+    // Returns bytes written, 0 on EAGAIN, -1 if the socket is broken
+    ssize_t Write(iovec* iov, size_t count, int flags = 0);
+
+    const SOCKET socket_;
+    const size_t coalesce_bytes_;
+    const std::function<void()> schedule_flush_;
+    const ResourceAllocator<uint8_t> allocator_;
+    Messages messages_;
+    std::mutex messages_mtx_;
+    std::atomic_bool pending_; // set before any write, so the reactor can't miss an EPOLLOUT edge
+    bool blocked_;             // the socket took less than asked, waiting for EPOLLOUT
+    bool closed_;
+    size_t queued_bytes_;
+    std::atomic_size_t zero_copy_min_bytes_; // 0 while zero-copy is off
+    Watermarks watermarks_;
+    std::function<void(bool writable)> writable_cb_;
+    InFlights in_flight_;
+    uint32_t next_id_;                           // of the next zero-copy sendmsg()
+    uint32_t released_id_;                       // all ids before it are released
+    Ranges released_ahead_;                      // ranges released out of order
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
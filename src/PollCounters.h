@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "libsercli/PollStats.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// PollStats of one reactor: written by the reactor thread, read from any thread
+//
+class PollCounters
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void AddSpin(Clock::duration time, bool found)
+    {
+        Add(spin_ns_, time);
+        if (found) spin_wakeups_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void AddIdle(Clock::duration time, bool found)
+    {
+        Add(idle_ns_, time);
+        if (found) blocking_wakeups_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void AddTo(PollStats& stats) const
+    {
+        stats.spin_time += std::chrono::nanoseconds(spin_ns_.load(std::memory_order_relaxed));
+        stats.idle_time += std::chrono::nanoseconds(idle_ns_.load(std::memory_order_relaxed));
+        stats.spin_wakeups += spin_wakeups_.load(std::memory_order_relaxed);
+        stats.blocking_wakeups += blocking_wakeups_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static void Add(std::atomic<uint64_t>& ns, Clock::duration time)
+    {
+        auto count = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+
+        ns.fetch_add(static_cast<uint64_t>(count), std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> spin_ns_{0};
+    std::atomic<uint64_t> idle_ns_{0};
+    std::atomic<uint64_t> spin_wakeups_{0};
+    std::atomic<uint64_t> blocking_wakeups_{0};
+};
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "Reactor.h"
+
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+namespace nkhlab {
+namespace libsercli {
+
+Reactor::Reactor(size_t max_events, const BusyPollConfig& busy_poll)
+    : events_(std::max<size_t>(max_events, 1))
+    , spin_time_{busy_poll.spin_time}
+    , epoll_fd_{-1}
+    , wake_fd_{-1}
+    , stopped_{true}
+    , rounds_{0}
+    , routine_done_{true}
+{
+}
+
+Reactor::~Reactor()
+{
+    Stop();
+}
+
+bool Reactor::Start(const ThreadPlacement& placement)
+{
+    if (!stopped_) return true;
+
+    // Can't wait for itself to end
+    if (std::this_thread::get_id() == worker_thread_.get_id()) return false;
+
+    // Stopped from one of its handlers, that routine may still be finishing its round
+    Stop();
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) return false;
+
+    // Registered without a handler, it only interrupts epoll_wait()
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ == -1 || !Add(wake_fd_, EPOLLIN, nullptr))
+    {
+        Stop();
+        return false;
+    }
+
+    stopped_ = false;
+    routine_done_ = false;
+    placement_ = placement;
+
+    std::promise<void> ready;
+    auto ready_future = ready.get_future();
+
+    worker_thread_ = std::thread(&Reactor::Routine, this, &ready);
+    ready_future.wait();
+
+    return true;
+}
+
+void Reactor::Stop()
+{
+    stopped_ = true;
+
+    // From a handler the routine ends after this round, the next Start() or Stop() joins it
+    if (std::this_thread::get_id() == worker_thread_.get_id()) return;
+
+    if (worker_thread_.joinable())
+    {
+        Wake();
+        worker_thread_.join();
+    }
+
+    if (epoll_fd_ != -1)
+    {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+
+    if (wake_fd_ != -1)
+    {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+}
+
+bool Reactor::Add(SOCKET socket, uint32_t events, IReactorHandler* handler)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.ptr = handler;
+
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &event) != -1;
+}
+
+bool Reactor::Modify(SOCKET socket, uint32_t events, IReactorHandler* handler)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.ptr = handler;
+
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket, &event) != -1;
+}
+
+void Reactor::Remove(SOCKET socket)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+void Reactor::Sync()
+{
+    if (stopped_ || std::this_thread::get_id() == worker_thread_.get_id()) return;
+
+    std::unique_lock<std::mutex> lk(rounds_mtx_);
+
+    // The round in progress may still hold events taken before the caller's changes
+    uint64_t target = rounds_ + 1;
+
+    Wake();
+    rounds_cv_.wait(lk, [&]() { return rounds_ >= target || routine_done_; });
+}
+
+void Reactor::AddPollStats(PollStats& stats) const
+{
+    poll_counters_.AddTo(stats);
+}
+
+void Reactor::Wake()
+{
+    eventfd_write(wake_fd_, 1);
+}
+
+int Reactor::Spin(int max_events)
+{
+    auto start = PollCounters::Clock::now();
+    auto now = start;
+    int num_events;
+
+    do
+    {
+        num_events = epoll_wait(epoll_fd_, events_.data(), max_events, 0);
+        now = PollCounters::Clock::now();
+    } while (num_events == 0 && !stopped_ && now - start < spin_time_);
+
+    poll_counters_.AddSpin(now - start, num_events > 0);
+
+    return num_events;
+}
+
+void Reactor::Routine(std::promise<void>* ready)
+{
+    ApplyThreadPlacement(placement_);
+    ready->set_value();
+
+    // Handlers over their read budget re-arm with EPOLL_CTL_MOD, behind the other ready sockets
+    int max_events = static_cast<int>(std::min<size_t>(events_.size(), INT_MAX));
+
+    while (!stopped_)
+    {
+        int num_events = spin_time_.count() > 0 ? Spin(max_events) : 0;
+
+        if (num_events == 0)
+        {
+            auto start = PollCounters::Clock::now();
+
+            // No timeout, Stop() and Sync() wake it up
+            num_events = epoll_wait(epoll_fd_, events_.data(), max_events, -1);
+
+            poll_counters_.AddIdle(PollCounters::Clock::now() - start, num_events > 0);
+        }
+
+        if (num_events == -1)
+        {
+            if (errno == EINTR) continue;
+            // Handle error
+            break;
+        }
+
+        for (int i = 0; i < num_events; ++i)
+        {
+            auto handler = static_cast<IReactorHandler*>(events_[i].data.ptr);
+
+            if (handler)
+            {
+                handler->HandleEvents(events_[i].events);
+            }
+            else
+            {
+                eventfd_t value;
+                eventfd_read(wake_fd_, &value);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(rounds_mtx_);
+            ++rounds_;
+        }
+        rounds_cv_.notify_all();
+    }
+
+    // Nothing is handled any more, release whoever waits in Sync()
+    {
+        std::lock_guard<std::mutex> lk(rounds_mtx_);
+        routine_done_ = true;
+    }
+    rounds_cv_.notify_all();
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
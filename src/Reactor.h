@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libsercli/BusyPollConfig.h"
+#include "libsercli/PollStats.h"
+
+#include "PollCounters.h"
+#include "SmartSocket.h"
+#include "ThreadPlacement.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Anything registered in a Reactor: listeners, server side client connections, etc.
+// HandleEvents() is always called from the reactor thread.
+//
+class IReactorHandler
+{
+public:
+    virtual ~IReactorHandler() = default;
+
+    virtual void HandleEvents(uint32_t events) = 0;
+};
+
+//
+// One epoll instance served by one thread, blocking until there are events or it is woken up
+// through an eventfd. Add/Modify/Remove are thread safe (they are plain epoll_ctl calls),
+// handlers must stay alive while they are registered.
+//
+class Reactor
+{
+public:
+    // max_events: events taken from epoll per epoll_wait() call
+    explicit Reactor(size_t max_events, const BusyPollConfig& busy_poll = BusyPollConfig());
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    //
+    // Returns once the reactor thread runs, false when called from it.
+    // placement: name and CPU of the reactor thread
+    //
+    bool Start(const ThreadPlacement& placement = ThreadPlacement());
+    //
+    // Wakes the reactor thread and waits for it to finish. From a handler it only asks the thread
+    // to finish after the current round, the Reactor must not be destroyed there.
+    //
+    void Stop();
+
+    bool Add(SOCKET socket, uint32_t events, IReactorHandler* handler);
+    bool Modify(SOCKET socket, uint32_t events, IReactorHandler* handler);
+    void Remove(SOCKET socket);
+
+    //
+    // Waits until the events already taken from epoll are handled, so a handler removed before
+    // is not called any more and can go. Returns at once on the reactor thread.
+    //
+    void Sync();
+
+    // Adds this reactor's counters, thread safe
+    void AddPollStats(PollStats& stats) const;
+
+private:
+    void Routine(std::promise<void>* ready);
+    void Wake();
+    // Polls without blocking for up to spin_time_, returns what epoll_wait() did last
+    int Spin(int max_events);
+
+    std::vector<epoll_event> events_;
+    const PollCounters::Clock::duration spin_time_;
+    PollCounters poll_counters_;
+    int epoll_fd_;
+    int wake_fd_;
+    std::atomic_bool stopped_;
+    std::thread worker_thread_;
+    ThreadPlacement placement_;
+
+    uint64_t rounds_; // epoll_wait() calls handled so far
+    bool routine_done_;
+    std::mutex rounds_mtx_;
+    std::condition_variable rounds_cv_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
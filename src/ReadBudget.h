@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "libsercli/ReadBudgetConfig.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// What one connection may still read in the current event loop iteration. Not thread safe.
+//
+class ReadBudget
+{
+public:
+    explicit ReadBudget(const ReadBudgetConfig& config)
+        : bytes_left_{config.max_bytes}
+        , messages_left_{config.max_messages}
+        , limit_bytes_{config.max_bytes > 0}
+        , limit_messages_{config.max_messages > 0}
+    {
+    }
+
+    void Spend(size_t bytes, size_t messages)
+    {
+        bytes_left_ -= bytes < bytes_left_ ? bytes : bytes_left_;
+        messages_left_ -= messages < messages_left_ ? messages : messages_left_;
+    }
+
+    bool IsExhausted() const
+    {
+        return (limit_bytes_ && bytes_left_ == 0) || (limit_messages_ && messages_left_ == 0);
+    }
+
+private:
+    size_t bytes_left_;
+    size_t messages_left_;
+    const bool limit_bytes_;
+    const bool limit_messages_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
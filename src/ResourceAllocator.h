@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "libsercli/MemoryResource.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Memory from the resource, from the global heap without one
+//
+inline void* AllocateFrom(MemoryResource* resource, size_t bytes, size_t alignment)
+{
+    if (resource) return resource->Allocate(bytes, alignment);
+
+    return ::operator new(bytes);
+}
+
+inline void DeallocateTo(MemoryResource* resource, void* p, size_t bytes, size_t alignment)
+{
+    if (resource)
+        resource->Deallocate(p, bytes, alignment);
+    else
+        ::operator delete(p);
+}
+
+//
+// Standard allocator on top of a MemoryResource, for containers and std::allocate_shared()
+//
+template <class T>
+class ResourceAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ResourceAllocator(MemoryResource* resource = nullptr)
+        : resource_{resource}
+    {
+    }
+
+    template <class U>
+    ResourceAllocator(const ResourceAllocator<U>& other)
+        : resource_{other.GetResource()}
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(AllocateFrom(resource_, n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) { DeallocateTo(resource_, p, n * sizeof(T), alignof(T)); }
+
+    MemoryResource* GetResource() const { return resource_; }
+
+private:
+    MemoryResource* resource_;
+};
+
+template <class T, class U>
+bool operator==(const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+{
+    return a.GetResource() == b.GetResource();
+}
+
+template <class T, class U>
+bool operator!=(const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+{
+    return !(a == b);
+}
+
+template <class T>
+struct ResourceDeleter
+{
+    MemoryResource* resource = nullptr;
+
+    void operator()(T* p) const
+    {
+        p->~T();
+        DeallocateTo(resource, p, sizeof(T), alignof(T));
+    }
+};
+
+template <class T>
+using ResourceUniquePtr = std::unique_ptr<T, ResourceDeleter<T>>;
+
+template <class T, class... Args>
+ResourceUniquePtr<T> MakeResourceUnique(MemoryResource* resource, Args&&... args)
+{
+    void* mem = AllocateFrom(resource, sizeof(T), alignof(T));
+
+    try
+    {
+        return ResourceUniquePtr<T>(
+            new (mem) T(std::forward<Args>(args)...), ResourceDeleter<T>{resource});
+    }
+    catch (...)
+    {
+        DeallocateTo(resource, mem, sizeof(T), alignof(T));
+        throw;
+    }
+}
+
+} // namespace libsercli
+} // namespace nkhlab
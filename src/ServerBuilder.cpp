@@ -13,24 +13,36 @@
 
 #include "Macros.h"
 #include "SocketServer.h"
+#include "UringSocketServer.h"
 #include "libsercli/ServerBuilder.h"
 
 namespace nkhlab {
 namespace libsercli {
 
-IServerPtr CreateUnixServer(const char* socket_path)
+IServerPtr CreateUnixServer(const char* socket_path, const ServerConfig& config)
 {
 #ifdef __linux__
-    return std::make_unique<SocketServer<UnixSocket>>(socket_path);
+    if (config.backend == Backend::kIoUring)
+    {
+        return std::make_unique<UringSocketServer<UnixSocket>>(config, socket_path);
+    }
+    return std::make_unique<SocketServer<UnixSocket>>(config, socket_path);
 #else
     UNUSED(socket_path);
+    UNUSED(config);
     return nullptr;
 #endif
 }
 
-IServerPtr CreateInetServer(const char* address, int port)
+IServerPtr CreateInetServer(const char* address, int port, const ServerConfig& config)
 {
-    return std::make_unique<SocketServer<InetSocket>>(address, port);
+#ifdef __linux__
+    if (config.backend == Backend::kIoUring)
+    {
+        return std::make_unique<UringSocketServer<InetSocket>>(config, address, port);
+    }
+#endif
+    return std::make_unique<SocketServer<InetSocket>>(config, address, port);
 }
 
 } // namespace libsercli
@@ -11,6 +11,10 @@
 
 #include "SmartSocket.h"
 
+#include <vector>
+
+#include "Macros.h"
+
 namespace nkhlab {
 namespace libsercli {
 
@@ -38,10 +42,10 @@ WinsockInitializer::~WinsockInitializer()
 #endif
 
 template <>
-bool StartSocket<Server>(SOCKET sock, sockaddr* addr, size_t len)
+bool StartSocket<Server>(SOCKET sock, sockaddr* addr, size_t len, int backlog)
 {
     if (bind(sock, addr, static_cast<socklen_t>(len)) != kSocketError &&
-        listen(sock, SOMAXCONN) != kSocketError)
+        listen(sock, backlog > 0 ? backlog : SOMAXCONN) != kSocketError)
     {
         return true;
     }
@@ -50,8 +54,10 @@ bool StartSocket<Server>(SOCKET sock, sockaddr* addr, size_t len)
 }
 
 template <>
-bool StartSocket<Client>(SOCKET sock, sockaddr* addr, size_t len)
+bool StartSocket<Client>(SOCKET sock, sockaddr* addr, size_t len, int backlog)
 {
+    UNUSED(backlog);
+
     if (connect(sock, addr, static_cast<socklen_t>(len)) != kSocketError)
     {
         return true;
@@ -60,6 +66,68 @@ bool StartSocket<Client>(SOCKET sock, sockaddr* addr, size_t len)
     return false;
 }
 
+bool SetIntOption(SOCKET sock, int level, int name, int value)
+{
+    return setsockopt(
+               sock,
+               level,
+               name,
+               reinterpret_cast<const char*>(&value),
+               static_cast<socklen_t>(sizeof(value))) != kSocketError;
+}
+
+bool ApplySocketOptions(SOCKET sock, const SocketOptions& options, bool tcp)
+{
+    bool ok = true;
+
+    if (tcp && options.tcp_nodelay) ok = ok && SetIntOption(sock, IPPROTO_TCP, TCP_NODELAY, 1);
+    if (options.send_buffer_size > 0)
+        ok = ok && SetIntOption(sock, SOL_SOCKET, SO_SNDBUF, options.send_buffer_size);
+    if (options.receive_buffer_size > 0)
+        ok = ok && SetIntOption(sock, SOL_SOCKET, SO_RCVBUF, options.receive_buffer_size);
+#ifdef __linux__
+    if (tcp && options.tcp_quickack) ok = ok && SetIntOption(sock, IPPROTO_TCP, TCP_QUICKACK, 1);
+    if (options.busy_poll_us > 0)
+        ok = ok && SetIntOption(sock, SOL_SOCKET, SO_BUSY_POLL, options.busy_poll_us);
+    if (options.priority > 0)
+        ok = ok && SetIntOption(sock, SOL_SOCKET, SO_PRIORITY, options.priority);
+#endif
+
+    return ok;
+}
+
+#ifdef __linux__
+bool SetNonBlocking(SOCKET sock)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+
+    return flags != -1 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+#else
+bool WriteAll(SOCKET sock, const DataView* data, size_t count)
+{
+    std::vector<WSABUF> wsa_bufs(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        wsa_bufs[i].buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(data[i].data()));
+        wsa_bufs[i].len = static_cast<ULONG>(data[i].size());
+    }
+
+    // Blocking socket: WSASend returns once everything is sent
+    DWORD bytes_sent = 0;
+
+    return WSASend(
+               sock,
+               wsa_bufs.data(),
+               static_cast<DWORD>(wsa_bufs.size()),
+               &bytes_sent,
+               0,
+               nullptr,
+               nullptr) != SOCKET_ERROR;
+}
+#endif
+
 // Specialization for Unix
 #ifdef __linux__
 template <>
@@ -96,6 +164,14 @@ template <>
 void SmartSocket<Server, InetSocket>::Open()
 {
     sock_ = socket(AF_INET, SOCK_STREAM, 0);
+
+#ifdef __linux__
+    //
+    // A restarted server binds its port again while connections it closed sit in TIME_WAIT.
+    // Not on Windows, where the option lets another socket take over a port in use.
+    //
+    if (sock_ != kSocketError) SetIntOption(sock_, SOL_SOCKET, SO_REUSEADDR, 1);
+#endif
 }
 
 template <>
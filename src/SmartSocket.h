@@ -13,7 +13,9 @@
 
 #ifdef __linux__
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -23,8 +25,12 @@
 #include <ws2tcpip.h>
 #endif
 
+#include <cstdint>
 #include <string>
 
+#include "libsercli/DataView.h"
+#include "libsercli/SocketOptions.h"
+
 namespace nkhlab {
 namespace libsercli {
 
@@ -54,8 +60,20 @@ class Client;
 class UnixSocket;
 class InetSocket;
 
+// backlog: pending connections of a Server socket, 0 for SOMAXCONN
 template <class RoleT>
-bool StartSocket(SOCKET sock, sockaddr* addr, size_t len);
+bool StartSocket(SOCKET sock, sockaddr* addr, size_t len, int backlog);
+
+bool SetIntOption(SOCKET sock, int level, int name, int value);
+
+// tcp: the TCP level options apply
+bool ApplySocketOptions(SOCKET sock, const SocketOptions& options, bool tcp);
+
+#ifdef __linux__
+bool SetNonBlocking(SOCKET sock);
+#else
+bool WriteAll(SOCKET sock, const DataView* data, size_t count);
+#endif
 
 template <class SockAddrT>
 class BaseSocket
@@ -86,10 +104,15 @@ public:
     UnixSocket(const char* path)
         : path_{path}
     {
+        sock_addr_ = {};
         sock_addr_.sun_family = AF_UNIX;
         strncpy(sock_addr_.sun_path, path_.c_str(), sizeof(sock_addr_.sun_path));
     }
 
+    // a path can be bound only once, so several listeners can't share it
+    static constexpr bool kReusePort = false;
+    static constexpr bool kTcp = false;
+
 protected:
     const std::string path_;
 };
@@ -100,8 +123,7 @@ class InetSocket : public BaseSocket<sockaddr_in>
 public:
     InetSocket(const char* address, int port)
     {
-        sock_ = socket(AF_INET, SOCK_STREAM, 0);
-
+        sock_addr_ = {};
         sock_addr_.sin_family = AF_INET;
 #ifdef __linux__
         sock_addr_.sin_addr.s_addr = inet_addr(address);
@@ -111,6 +133,13 @@ public:
         sock_addr_.sin_port = htons(static_cast<u_short>(port));
 #endif
     }
+
+#ifdef __linux__
+    static constexpr bool kReusePort = true;
+#else
+    static constexpr bool kReusePort = false;
+#endif
+    static constexpr bool kTcp = true;
 };
 
 template <class RoleT, class SocketT>
@@ -133,11 +162,11 @@ public:
     SmartSocket(const SmartSocket&) = delete;
     SmartSocket& operator=(const SmartSocket&) = delete;
 
-    void Start()
+    void Start(int backlog = 0)
     {
         if (!started_ && SocketT::sock_ != kSocketError)
         {
-            if (StartSocket<RoleT>(SocketT::sock_, SocketT::GetAddr(), SocketT::GetLen()))
+            if (StartSocket<RoleT>(SocketT::sock_, SocketT::GetAddr(), SocketT::GetLen(), backlog))
             {
                 started_ = true;
             }
@@ -148,6 +177,23 @@ public:
         }
     }
 
+    //
+    // To be called before Start(), the socket is closed if the system refuses an option
+    //
+    void ApplyOptions(const SocketOptions& options)
+    {
+        if (SocketT::sock_ == kSocketError) return;
+
+        if (!ApplySocketOptions(SocketT::sock_, options, SocketT::kTcp)) Close();
+    }
+
+    bool SetOption(int level, int name, int value)
+    {
+        if (SocketT::sock_ == kSocketError) return false;
+
+        return SetIntOption(SocketT::sock_, level, name, value);
+    }
+
 #ifdef __linux__
 #else
     //
@@ -16,34 +16,83 @@
 #endif
 
 #include <atomic>
+#include <cerrno>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
 
+#include "libsercli/ClientConfig.h"
 #include "libsercli/IClient.h"
 
+#include "BufferPool.h"
+#include "CallbackAdapters.h"
+#include "ClientEventLoop.h"
 #include "Constants.h"
+#include "FlushTimer.h"
+#include "Framing.h"
+#include "OutboundQueue.h"
+#include "ReadBudget.h"
+#include "Reactor.h"
+#include "ResourceAllocator.h"
 #include "SmartSocket.h"
+#include "ThreadPlacement.h"
 
 namespace nkhlab {
 namespace libsercli {
 
-constexpr int kStopHandleTimeout_ms = 500;
-
 template <class SocketT>
-class SocketClient : public IClient
+class SocketClient
+    : public IClient
+#ifdef __linux__
+    , private IReactorHandler
+#endif
 {
 public:
     template <class... Args>
-    SocketClient(const Args&... args)
+    SocketClient(const ClientConfig& config, const Args&... args)
         : smart_socket_{args...}
         , disconnected_{true}
+        , reading_paused_{false}
+        , receive_pool_{BufferPool::Create(
+              config.socket_options.receive_chunk_size,
+              config.receive_pool,
+              config.event_loop ? -1 : GetBufferNode(config.io_thread, 0),
+              config.memory_resource)}
+        , max_frame_size_{config.framing.enabled ? config.framing.max_frame_size : 0}
+        , memory_resource_{config.memory_resource}
+#ifdef __linux__
+        , event_loop_{config.event_loop}
+        , own_reactor_{config.read_budget.max_events, config.busy_poll}
+        , reactor_{nullptr}
+        , last_reactor_{nullptr}
+        , read_budget_{config.read_budget}
+        , placement_{GetThreadPlacement(config.io_thread, "sercli-cli", 0)}
+        , outbound_queue_{
+              smart_socket_.GetRawSocket(),
+              config.write_coalescing.max_bytes,
+              config.write_coalescing.max_bytes > 0
+                  ? std::function<void()>([this]() { flush_timer_->Schedule(0); })
+                  : nullptr,
+              memory_resource_}
+#endif
     {
+        smart_socket_.ApplyOptions(config.socket_options);
+
 #ifdef __linux__
+        if (config.write_coalescing.max_bytes > 0)
+        {
+            flush_timer_ = std::make_unique<FlushTimer>(
+                config.write_coalescing.max_delay, [this](SOCKET) { outbound_queue_.Flush(); });
+        }
+
+        // Not supported by UNIX sockets, they stay on plain sends
+        outbound_queue_.EnableZeroCopy(config.zero_copy_min_bytes);
+        outbound_queue_.SetWatermarks(config.send_watermarks, [this](bool writable) {
+            if (writable_cb_) writable_cb_(writable);
+        });
 #else
-        receive_buffer_.reserve(kDataBufferSize);
-        receive_buffer_.resize(kDataBufferSize);
-        wsa_receive_buf_.buf = reinterpret_cast<CHAR*>(receive_buffer_.data());
-        wsa_receive_buf_.len = static_cast<ULONG>(receive_buffer_.size());
         wsa_receive_flags_ = 0;
         wsa_overlapped_ = {};
 #endif
@@ -52,9 +101,32 @@ public:
     ~SocketClient()
     {
         Disconnect();
+#ifdef __linux__
+        // Disconnected from its own callback, the I/O thread may still be finishing that round
+        own_reactor_.Stop();
+
+        Reactor* last_reactor = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(reading_mtx_);
+            last_reactor = last_reactor_;
+        }
+        if (last_reactor) last_reactor->Sync();
+#endif
     }
 
     bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientDataReceivedCb data_received_cb) override
+    {
+        return Connect(server_disconnected_cb, ToBufferReceivedCb(data_received_cb));
+    }
+
+    bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientDataViewReceivedCb data_received_cb)
+        override
+    {
+        return Connect(server_disconnected_cb, ToBufferReceivedCb(data_received_cb));
+    }
+
+    bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientBufferReceivedCb data_received_cb)
+        override
     {
         bool ret = false;
 
@@ -62,10 +134,27 @@ public:
 
         if (smart_socket_.GetRawSocket() != kSocketError)
         {
+            if (max_frame_size_ > 0)
+            {
+                frame_decoder_ = MakeResourceUnique<FrameDecoder>(
+                    memory_resource_, receive_pool_.get(), max_frame_size_);
+            }
+
+#ifdef __linux__
+            if (!SetNonBlocking(smart_socket_.GetRawSocket())) return false;
+            if (flush_timer_ && !flush_timer_->Open()) return false;
+            outbound_queue_.Open();
+
+            server_disconnected_cb_ = server_disconnected_cb;
+            data_received_cb_ = data_received_cb;
+
+            ret = Register();
+#else
             disconnected_ = false;
             worker_thread_ =
                 std::thread(&SocketClient::Routine, this, server_disconnected_cb, data_received_cb);
             ret = true;
+#endif
         }
 
         return ret;
@@ -75,103 +164,301 @@ public:
     {
         disconnected_ = true;
 #ifdef __linux__
+        Unregister();
+        outbound_queue_.Close();
+        if (flush_timer_) flush_timer_->Close();
 #else
         smart_socket_.ForceClose();
-#endif
         if (worker_thread_.joinable()) worker_thread_.join();
+#endif
     }
 
+    void SetWritableCb(WritableCb writable_cb) override
+    {
+        writable_cb_ = writable_cb;
+    }
+
+    using IClient::Send;
+    using IClient::SendZeroCopy;
+
     bool Send(const std::vector<uint8_t>& data) override
+    {
+        return Send(data, nullptr);
+    }
+
+    bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) override
+    {
+        DataView view(data);
+
+        return Send(&view, 1, std::move(completed_cb));
+    }
+
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) override
     {
         if (disconnected_) return false;
 
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
 #ifdef __linux__
-        ssize_t bytes_written = write(smart_socket_.GetRawSocket(), data.data(), data.size());
+        return outbound_queue_.Send(frame.data(), frame.count(), std::move(completed_cb));
 #else
-        ssize_t bytes_written = send(
-            smart_socket_.GetRawSocket(),
-            reinterpret_cast<const char*>(data.data()),
-            static_cast<int>(data.size()),
-            0);
+        bool sent = WriteAll(smart_socket_.GetRawSocket(), frame.data(), frame.count());
+
+        if (sent && completed_cb) completed_cb(true);
+        return sent;
 #endif
-        if (bytes_written == -1 || bytes_written != static_cast<ssize_t>(data.size())) return false;
+    }
 
-        return true;
+    bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        if (disconnected_) return false;
+
+#ifdef __linux__
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
+        return outbound_queue_.SendZeroCopy(
+            frame.data(), frame.count(), frame.KeepHeader(std::move(completed_cb)));
+#else
+        return Send(data, count, std::move(completed_cb));
+#endif
+    }
+
+    bool Flush() override
+    {
+        if (disconnected_) return false;
+
+#ifdef __linux__
+        return outbound_queue_.Flush();
+#else
+        return true; // nothing is held back
+#endif
+    }
+
+    void PauseReading() override
+    {
+        SetReadingPaused(true);
+    }
+
+    void ResumeReading() override
+    {
+        SetReadingPaused(false);
+    }
+
+    bool IsWritable() override
+    {
+#ifdef __linux__
+        return outbound_queue_.IsWritable();
+#else
+        return true; // sends don't return before the data is written
+#endif
+    }
+
+    PollStats GetPollStats() override
+    {
+        PollStats stats;
+#ifdef __linux__
+        std::lock_guard<std::mutex> lk(reading_mtx_);
+        (reactor_ ? reactor_ : &own_reactor_)->AddPollStats(stats);
+#endif
+        return stats;
     }
 
 private:
+    void SetReadingPaused(bool paused)
+    {
+#ifdef __linux__
+        std::lock_guard<std::mutex> lk(reading_mtx_);
+
+        reading_paused_ = paused;
+
+        if (reactor_) reactor_->Modify(smart_socket_.GetRawSocket(), GetEvents(), this);
+#else
+        UNUSED(paused);
+#endif
+    }
+
 #ifdef __linux__
-    void Routine(ServerDisconnectedCb server_disconnected_cb, ClientDataReceivedCb data_received_cb)
+    // Edge-triggered mode, EPOLLOUT edges flush the outbound queue
+    uint32_t GetEvents() const
+    {
+        return reading_paused_ ? EPOLLOUT | EPOLLET : EPOLLIN | EPOLLOUT | EPOLLET;
+    }
+
+    //
+    // Edge-triggered mode reports a socket with data left only once, EPOLL_CTL_MOD reports it
+    // again and queues it behind the sockets already ready
+    //
+    void RearmReading()
     {
-        int epoll_fd = epoll_create1(0);
-        if (epoll_fd == -1)
+        std::lock_guard<std::mutex> lk(reading_mtx_);
+
+        if (reactor_) reactor_->Modify(smart_socket_.GetRawSocket(), GetEvents(), this);
+    }
+
+    //
+    // Puts the socket on the shared event loop if configured, on a reactor of its own otherwise
+    //
+    bool Register()
+    {
+        Reactor* reactor = nullptr;
+
+        if (event_loop_)
+        {
+            auto event_loop = dynamic_cast<ClientEventLoop*>(event_loop_.get());
+            if (!event_loop) return false; // not made by CreateClientEventLoop()
+
+            reactor = event_loop->NextReactor();
+        }
+        else
+        {
+            if (!own_reactor_.Start(placement_)) return false;
+
+            reactor = &own_reactor_;
+        }
+
+        disconnected_ = false;
+
+        bool added = false;
+
+        {
+            std::lock_guard<std::mutex> lk(reading_mtx_);
+
+            reactor_ = reactor;
+            added = reactor_->Add(smart_socket_.GetRawSocket(), GetEvents(), this);
+        }
+
+        if (!added ||
+            (flush_timer_ && !reactor->Add(flush_timer_->GetFd(), EPOLLIN, flush_timer_.get())))
         {
-            // Handle error
             disconnected_ = true;
+            Unregister();
+            return false;
         }
 
-        epoll_event client_event;
-        client_event.data.fd = smart_socket_.GetRawSocket();
-        client_event.events = EPOLLIN;
-        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, smart_socket_.GetRawSocket(), &client_event);
-        constexpr int MAX_EVENTS = 10; // TODO: why?
-        std::vector<epoll_event> events(MAX_EVENTS);
+        return true;
+    }
+
+    //
+    // Once it returns, no handler of this client runs or will be called any more.
+    // From the client's own callback only that handler is left to return.
+    //
+    void Unregister()
+    {
+        Reactor* reactor = nullptr;
 
-        while (!disconnected_)
         {
-            int num_events = epoll_wait(
-                epoll_fd,
-                events.data(),
-                MAX_EVENTS,
-                kStopHandleTimeout_ms); // if pass __timeout as -1 - no timeout
-            if (num_events == -1)
+            std::lock_guard<std::mutex> lk(reading_mtx_);
+            std::swap(reactor, reactor_);
+            if (reactor) last_reactor_ = reactor;
+        }
+
+        if (!reactor) return;
+
+        reactor->Remove(smart_socket_.GetRawSocket());
+        if (flush_timer_) reactor->Remove(flush_timer_->GetFd());
+
+        if (reactor == &own_reactor_)
+            own_reactor_.Stop();
+        else
+            reactor->Sync();
+    }
+
+    void HandleEvents(uint32_t events) override
+    {
+        if (disconnected_) return;
+
+        // Zero-copy completions are reported on the error queue
+        if (events & EPOLLERR) outbound_queue_.ReapZeroCopy();
+
+        // Handle data from Server, then send what the callback replied in one batch
+        if (((events & EPOLLOUT) && !outbound_queue_.Flush()) || !Receive(data_received_cb_) ||
+            (flush_timer_ && !outbound_queue_.Flush()))
+        {
+            // Server disconnected, the socket stays registered until Disconnect()
+            disconnected_ = true;
+            outbound_queue_.Close();
+            if (server_disconnected_cb_) server_disconnected_cb_();
+        }
+    }
+
+    //
+    // Edge-triggered mode: the socket has to be drained until EAGAIN,
+    // whatever is left there would wait for the next data from the Server.
+    // Returns false when the Server disconnected or the connection is broken.
+    //
+    bool Receive(ClientBufferReceivedCb& data_received_cb)
+    {
+        ReadBudget budget(read_budget_);
+
+        // Frames held back by a pause go first, resuming reports the socket again
+        if (unread_ && !reading_paused_ && !disconnected_)
+        {
+            Buffer unread = std::move(unread_);
+
+            if (!DeliverReceived(data_received_cb, unread))
             {
-                // Handle error
-                break;
+                shutdown(smart_socket_.GetRawSocket(), SHUT_RDWR);
+                return false;
             }
-            else if (num_events == 0)
+        }
+
+        // Paused data waits in the socket, EPOLL_CTL_MOD reports it again once resumed.
+        // Disconnect() may come from the callback.
+        while (!reading_paused_ && !disconnected_)
+        {
+            if (budget.IsExhausted())
             {
-                // Timeout occurred, no events - we use it to handle stop request
+                // The rest is read on a later round, other clients of a shared loop go first
+                RearmReading();
+                break;
             }
 
-            for (int i = 0; i < num_events; ++i)
+            // a buffer still retained by a callback can't be reused, take a fresh one
+            if (receive_buffer_.UseCount() != 1) receive_buffer_ = receive_pool_->Acquire();
+
+            ssize_t received_bytes = read(
+                smart_socket_.GetRawSocket(),
+                BufferPool::MutableData(receive_buffer_),
+                BufferPool::Capacity(receive_buffer_));
+            if (received_bytes > 0)
             {
-                if (events[i].data.fd == smart_socket_.GetRawSocket())
+                size_t messages = 1;
+
+                // Handle received data
+                if (data_received_cb)
                 {
-                    // Handle data from Server
-                    std::vector<uint8_t> buffer(kDataBufferSize);
+                    BufferPool::SetSize(receive_buffer_, received_bytes);
 
-                    int received_bytes =
-                        read(smart_socket_.GetRawSocket(), buffer.data(), buffer.size());
-                    if (received_bytes == 0)
+                    if (!DeliverReceived(data_received_cb, receive_buffer_, &messages))
                     {
-                        // Server disconnected
-                        if (server_disconnected_cb) server_disconnected_cb();
-                        disconnected_ = true;
-                        break;
-                        break;
-                    }
-                    else if (received_bytes < 0)
-                    {
-                        // Error occurred
-                    }
-                    else
-                    {
-                        // Handle received data
-                        if (data_received_cb)
-                        {
-                            buffer.resize(received_bytes);
-                            data_received_cb(buffer);
-                        }
+                        // Broken framing, the stream can't be followed any more
+                        shutdown(smart_socket_.GetRawSocket(), SHUT_RDWR);
+                        return false;
                     }
                 }
+
+                budget.Spend(static_cast<size_t>(received_bytes), messages);
+            }
+            else if (received_bytes == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (received_bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return true;
+            }
+            else
+            {
+                return false;
             }
         }
 
-        if (epoll_fd != -1) close(epoll_fd);
+        return true;
     }
 #else
-    void Routine(ServerDisconnectedCb server_disconnected_cb, ClientDataReceivedCb data_received_cb)
+    void Routine(ServerDisconnectedCb server_disconnected_cb, ClientBufferReceivedCb data_received_cb)
     {
         LPWSAOVERLAPPED wsa_recv_overlapped = &wsa_overlapped_;
         wsa_recv_overlapped->hEvent = WSACreateEvent();
@@ -180,6 +467,13 @@ private:
         {
             while (!disconnected_)
             {
+                // a buffer still retained by a callback can't be reused, take a fresh one
+                if (receive_buffer_.UseCount() != 1) receive_buffer_ = receive_pool_->Acquire();
+
+                wsa_receive_buf_.buf =
+                    reinterpret_cast<CHAR*>(BufferPool::MutableData(receive_buffer_));
+                wsa_receive_buf_.len = static_cast<ULONG>(BufferPool::Capacity(receive_buffer_));
+
                 SOCKET wsa_recv_sock = smart_socket_.GetRawSocket();
                 LPWSABUF wsa_recv_buf = &wsa_receive_buf_;
                 LPDWORD wsa_recv_flags = &wsa_receive_flags_;
@@ -205,9 +499,15 @@ private:
                             {
                                 if (data_received_cb)
                                 {
-                                    receive_buffer_.resize(wsa_received_bytes);
-                                    data_received_cb(receive_buffer_);
-                                    receive_buffer_.resize(kDataBufferSize);
+                                    BufferPool::SetSize(receive_buffer_, wsa_received_bytes);
+
+                                    if (!DeliverReceived(data_received_cb, receive_buffer_))
+                                    {
+                                        // Broken framing, the stream can't be followed any more
+                                        shutdown(wsa_recv_sock, SD_BOTH);
+                                        if (server_disconnected_cb) server_disconnected_cb();
+                                        disconnected_ = true;
+                                    }
                                 }
                             }
 
@@ -223,12 +523,67 @@ private:
     WSAOVERLAPPED wsa_overlapped_;
     WSABUF wsa_receive_buf_;
     DWORD wsa_receive_flags_;
-    std::vector<uint8_t> receive_buffer_;
 #endif
 
+    //
+    // Hands received data to the callback, whole frames only with framing on.
+    // Frames left when reading is paused or disconnected from a callback are kept in unread_.
+    // messages, if given, is set to the number of callbacks made.
+    // Returns false when the Server sent a frame over the limit.
+    //
+    bool DeliverReceived(
+        ClientBufferReceivedCb& data_received_cb,
+        const Buffer& data,
+        size_t* messages = nullptr)
+    {
+        if (!frame_decoder_)
+        {
+            data_received_cb(data);
+            if (messages) *messages = 1;
+            return true;
+        }
+
+        size_t frames = 0;
+
+        bool ok = frame_decoder_->Feed(
+            data,
+            [&](const Buffer& frame) {
+                data_received_cb(frame);
+                ++frames;
+                return !reading_paused_ && !disconnected_;
+            },
+            &unread_);
+
+        if (messages) *messages = frames;
+
+        return ok;
+    }
+
     SmartSocket<Client, SocketT> smart_socket_;
-    std::thread worker_thread_;
     std::atomic_bool disconnected_;
+    std::atomic_bool reading_paused_;
+    BufferPoolPtr receive_pool_;
+    Buffer receive_buffer_;
+    const size_t max_frame_size_; // 0 with framing off
+    MemoryResource* const memory_resource_; // nullptr for the global heap
+    ResourceUniquePtr<FrameDecoder> frame_decoder_;
+    Buffer unread_; // frames of a chunk left when reading was paused, delivered on resume
+#ifdef __linux__
+    IClientEventLoopPtr event_loop_; // kept alive while the client may be registered there
+    Reactor own_reactor_;            // without a shared event loop
+    Reactor* reactor_;               // the one the socket is registered in
+    Reactor* last_reactor_;          // the one it was registered in last
+    std::mutex reading_mtx_; // guards reactor_ against reading being paused meanwhile
+    const ReadBudgetConfig read_budget_;
+    const ThreadPlacement placement_; // of the thread of its own
+    ServerDisconnectedCb server_disconnected_cb_;
+    ClientBufferReceivedCb data_received_cb_;
+    WritableCb writable_cb_;
+    std::unique_ptr<FlushTimer> flush_timer_; // write coalescing only
+    OutboundQueue outbound_queue_;
+#else
+    std::thread worker_thread_;
+#endif
 };
 
 } // namespace libsercli
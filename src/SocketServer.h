@@ -11,21 +11,33 @@
 
 #pragma once
 
-#ifdef __linux__
-#include <sys/epoll.h>
-#endif
-
 #include <algorithm>
 #include <atomic>
-#include <iterator>
-#include <map>
+#include <cerrno>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "BufferPool.h"
+#include "CallbackAdapters.h"
+#include "CallbackExecutor.h"
+#include "ClientTable.h"
+#include "ConnectionLimit.h"
 #include "Constants.h"
+#include "FlushTimer.h"
+#include "Macros.h"
+#include "OutboundQueue.h"
+#include "ReadBudget.h"
+#include "ResourceAllocator.h"
 #include "libsercli/IServer.h"
+#include "libsercli/ServerConfig.h"
 
+#include "Framing.h"
+#include "Reactor.h"
 #include "SmartSocket.h"
+#include "ThreadPlacement.h"
 
 namespace nkhlab {
 namespace libsercli {
@@ -34,21 +46,54 @@ template <class SocketT>
 class SocketServer;
 
 template <class SocketT>
-class SocketClientHandler : public IClientHandler
+class SocketClientHandler
+    : public IClientHandler
+    , public std::enable_shared_from_this<SocketClientHandler<SocketT>>
+#ifdef __linux__
+    , public IReactorHandler
+#endif
 {
 public:
-    SocketClientHandler(SOCKET client_socket, SocketServer<SocketT>* server)
+    SocketClientHandler(
+        SOCKET client_socket,
+        ClientId client_id,
+        SocketServer<SocketT>* server,
+        size_t shard)
         : socket_{client_socket}
         , server_{server}
-        , id_{std::to_string(client_socket)}
+        , shard_{shard}
+        , client_id_{client_id}
+        , id_{std::to_string(client_id)}
         , connected_{true}
+        , reading_paused_{false}
+        , max_frame_size_{server->framing_.enabled ? server->framing_.max_frame_size : 0}
+#ifdef __linux__
+        , outbound_queue_{
+              client_socket,
+              server->write_coalescing_.max_bytes,
+              server->MakeScheduleFlush(client_socket, shard),
+              server->memory_resource_}
+#endif
     {
+        if (max_frame_size_ > 0)
+        {
+            frame_decoder_ = MakeResourceUnique<FrameDecoder>(
+                server->memory_resource_, server->GetReceivePool(shard), max_frame_size_);
+        }
+
+        if (server->executor_)
+        {
+            strand_ = std::allocate_shared<CallbackStrand>(
+                ResourceAllocator<CallbackStrand>(server->memory_resource_));
+        }
+
 #ifdef __linux__
+        // Not supported by UNIX sockets, they stay on plain sends
+        outbound_queue_.EnableZeroCopy(server->zero_copy_min_bytes_);
+        outbound_queue_.SetWatermarks(server->send_watermarks_, [this](bool writable) {
+            server_->NotifyWritable(this, writable);
+        });
 #else
-        receive_buffer_.reserve(kDataBufferSize);
-        receive_buffer_.resize(kDataBufferSize);
-        wsa_receive_buf_.buf = reinterpret_cast<CHAR*>(receive_buffer_.data());
-        wsa_receive_buf_.len = static_cast<ULONG>(receive_buffer_.size());
         wsa_receive_flags_ = 0;
         wsa_overlapped_ = {};
 #endif
@@ -60,28 +105,156 @@ public:
         return id_;
     }
 
+    ClientId GetClientId() override
+    {
+        return client_id_;
+    }
+
     bool IsConnected() override
     {
         return connected_;
     }
+    using IClientHandler::Send;
+    using IClientHandler::SendZeroCopy;
+
     bool Send(const std::vector<uint8_t>& data) override
+    {
+        return Send(data, nullptr);
+    }
+
+    bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) override
+    {
+        DataView view(data);
+
+        return Send(&view, 1, std::move(completed_cb));
+    }
+
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) override
     {
         if (!connected_) return false;
 
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
 #ifdef __linux__
-        ssize_t bytes_written = write(socket_, data.data(), data.size());
+        return outbound_queue_.Send(frame.data(), frame.count(), std::move(completed_cb));
 #else
-        ssize_t bytes_written = send(
-            socket_, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()), 0);
+        bool sent = WriteAll(socket_, frame.data(), frame.count());
+
+        if (sent && completed_cb) completed_cb(true);
+        return sent;
 #endif
-        if (bytes_written == -1 || bytes_written != static_cast<ssize_t>(data.size())) return false;
+    }
 
-        return true;
+    bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        if (!connected_) return false;
+
+#ifdef __linux__
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
+        return outbound_queue_.SendZeroCopy(
+            frame.data(), frame.count(), frame.KeepHeader(std::move(completed_cb)));
+#else
+        return Send(data, count, std::move(completed_cb));
+#endif
+    }
+
+    bool Flush() override
+    {
+        if (!connected_) return false;
+
+#ifdef __linux__
+        return outbound_queue_.Flush();
+#else
+        return true; // nothing is held back
+#endif
+    }
+
+    void PauseReading() override
+    {
+        SetReadingPaused(true);
     }
 
+    void ResumeReading() override
+    {
+        SetReadingPaused(false);
+    }
+
+    bool IsWritable() override
+    {
+#ifdef __linux__
+        return outbound_queue_.IsWritable();
+#else
+        return true; // sends don't return before the data is written
+#endif
+    }
+
+#ifdef __linux__
+    void HandleEvents(uint32_t events) override
+    {
+        server_->HandleClientEvents(this, events);
+    }
+#endif
+
 private:
+    void SetReadingPaused(bool paused)
+    {
 #ifdef __linux__
+        std::lock_guard<std::mutex> lk(reading_mtx_);
+
+        reading_paused_ = paused;
+
+        // The socket is still open while connected, so it can't belong to anybody else yet
+        if (connected_) server_->UpdateReading(this);
 #else
+        UNUSED(paused);
+#endif
+    }
+
+    void MarkDisconnected()
+    {
+        std::lock_guard<std::mutex> lk(reading_mtx_);
+        connected_ = false;
+    }
+
+    //
+    // Broadcast payload, already framed: the queue refers to it until it is written
+    //
+    void SendShared(const SharedPayload& payload, BroadcastResult& result)
+    {
+        DataView view(*payload);
+
+#ifdef __linux__
+        if (connected_ && outbound_queue_.SendBorrowed(&view, 1, [payload](bool) {}))
+        {
+            ++result.sent;
+            if (outbound_queue_.IsBlocked()) ++result.backpressured;
+        }
+#else
+        if (connected_ && WriteAll(socket_, &view, 1))
+        {
+            ++result.sent;
+        }
+#endif
+        else
+        {
+            ++result.skipped;
+        }
+    }
+
+#ifdef __linux__
+#else
+    void PrepareReceive(BufferPool& pool)
+    {
+        // a buffer still retained by a callback can't be reused, take a fresh one
+        if (receive_buffer_.UseCount() != 1) receive_buffer_ = pool.Acquire();
+
+        wsa_receive_buf_.buf = reinterpret_cast<CHAR*>(BufferPool::MutableData(receive_buffer_));
+        wsa_receive_buf_.len = static_cast<ULONG>(BufferPool::Capacity(receive_buffer_));
+    }
+
     //
     // WSAOVERLAPPED must be the first field because it is used in dereferencing
     // to access all members (for example, in a completition routine callback)
@@ -89,12 +262,23 @@ private:
     WSAOVERLAPPED wsa_overlapped_;
     WSABUF wsa_receive_buf_;
     DWORD wsa_receive_flags_;
-    std::vector<uint8_t> receive_buffer_;
+    Buffer receive_buffer_;
 #endif
     const SOCKET socket_;
     SocketServer<SocketT>* server_;
+    const size_t shard_;
+    const ClientId client_id_;
     const std::string id_;
     std::atomic_bool connected_;
+    std::atomic_bool reading_paused_;
+    std::mutex reading_mtx_; // the socket is not closed while it is held
+    const size_t max_frame_size_; // 0 with framing off
+    ResourceUniquePtr<FrameDecoder> frame_decoder_; // only the receiving thread uses it
+    Buffer unread_; // frames of a chunk left when reading was paused, delivered on resume
+    CallbackStrandPtr strand_; // with a callback executor only
+#ifdef __linux__
+    OutboundQueue outbound_queue_;
+#endif
 
     friend class SocketServer<SocketT>;
 };
@@ -107,29 +291,177 @@ class SocketServer : public IServer
 {
 public:
     template <class... Args>
-    SocketServer(const Args&... args)
-        : smart_socket_{args...}
+    SocketServer(const ServerConfig& config, const Args&... args)
+        : memory_resource_{config.memory_resource}
+        , receive_pool_{BufferPool::Create(
+              config.socket_options.receive_chunk_size,
+              config.receive_pool,
+              -1,
+              memory_resource_)}
+        , write_coalescing_{config.write_coalescing}
+        , zero_copy_min_bytes_{config.zero_copy_min_bytes}
+        , framing_{config.framing}
+        , send_watermarks_{config.send_watermarks}
+        , read_budget_{config.read_budget}
+        , admission_{config.admission}
+        , io_threads_{config.io_threads}
+        , executor_{
+              config.callback_executor.threads > 0
+                  ? std::make_unique<CallbackExecutor>(config.callback_executor.threads)
+                  : nullptr}
         , stopped_{true}
+#ifdef __linux__
+        , connection_limit_{
+              config.admission.max_connections,
+              [this](bool accepting) { SetAccepting(accepting); }}
+#endif
     {
+        // The only one accepted sockets may not inherit from the listener
+        accepted_options_.tcp_quickack = config.socket_options.tcp_quickack;
+
+#ifdef __linux__
+        size_t reactors = std::max<size_t>(config.reactor_threads, 1);
+        size_t listeners = SocketT::kReusePort ? reactors : 1;
+
+        for (size_t i = 0; i < reactors; ++i)
+        {
+            auto shard = std::make_unique<Shard>(read_budget_.max_events, config.busy_poll);
+
+            int numa_node = GetBufferNode(io_threads_, i);
+
+            if (numa_node >= 0)
+            {
+                BufferPoolConfig pool_config = config.receive_pool;
+                pool_config.buffer_count = std::max<size_t>(pool_config.buffer_count / reactors, 1);
+
+                shard->receive_pool = BufferPool::Create(
+                    config.socket_options.receive_chunk_size,
+                    pool_config,
+                    numa_node,
+                    memory_resource_);
+            }
+
+            if (write_coalescing_.max_bytes > 0)
+            {
+                shard->flush_timer = std::make_unique<FlushTimer>(
+                    write_coalescing_.max_delay, [this](SOCKET socket) {
+                        auto client = clients_.FindBySocket(socket);
+
+                        //
+                        // A broken socket is reported to the client's own handler by epoll,
+                        // it is closed there
+                        //
+                        if (client) client->outbound_queue_.Flush();
+                    });
+            }
+
+            shards_.emplace_back(std::move(shard));
+        }
+
+        for (size_t i = 0; i < listeners; ++i)
+        {
+            auto listener = std::make_unique<Listener>(this, i, args...);
+
+            if (listeners > 1) listener->smart_socket.SetOption(SOL_SOCKET, SO_REUSEPORT, 1);
+            listener->smart_socket.ApplyOptions(config.socket_options);
+
+            listeners_.emplace_back(std::move(listener));
+        }
+#else
+        shards_.emplace_back(std::make_unique<Shard>());
+        listeners_.emplace_back(std::make_unique<Listener>(this, 0, args...));
+        listeners_.back()->smart_socket.ApplyOptions(config.socket_options);
+#endif
     }
 
     ~SocketServer() { Stop(); }
 
     bool Start(ClientStatusCb client_status_cb, ServerDataReceivedCb server_data_received_cb) override
     {
-        bool ret = false;
+        return Start(client_status_cb, ToBufferReceivedCb(server_data_received_cb));
+    }
+
+    bool Start(ClientStatusCb client_status_cb, ServerDataViewReceivedCb server_data_received_cb)
+        override
+    {
+        return Start(client_status_cb, ToBufferReceivedCb(server_data_received_cb));
+    }
+
+    bool Start(ClientStatusCb client_status_cb, ServerBufferReceivedCb server_data_received_cb)
+        override
+    {
+        return Start(client_status_cb, server_data_received_cb, nullptr);
+    }
+
+    bool Start(IServerHandler& handler) override { return Start(nullptr, nullptr, &handler); }
+
+    // Either the callbacks or the handler
+    bool Start(
+        ClientStatusCb client_status_cb,
+        ServerBufferReceivedCb server_data_received_cb,
+        IServerHandler* server_handler)
+    {
+        if (!stopped_) return false;
+
+        client_status_cb_ = client_status_cb;
+        server_data_received_cb_ = server_data_received_cb;
+        server_handler_ = server_handler;
+
+        for (auto& listener : listeners_)
+        {
+            listener->smart_socket.Start(admission_.backlog);
+
+            if (listener->smart_socket.GetRawSocket() == kSocketError) return false;
+#ifdef __linux__
+            // Accept() takes connections until EAGAIN
+            if (!SetNonBlocking(listener->smart_socket.GetRawSocket())) return false;
+#endif
+        }
+
+        stopped_ = false;
+
+        if (executor_) executor_->Start();
+
+#ifdef __linux__
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            auto& shard = shards_[i];
+
+            if (!shard->reactor.Start(GetThreadPlacement(io_threads_, "sercli-srv", i)))
+            {
+                Stop();
+                return false;
+            }
 
-        smart_socket_.Start();
+            if (shard->flush_timer)
+            {
+                if (!shard->flush_timer->Open() ||
+                    !shard->reactor.Add(
+                        shard->flush_timer->GetFd(), EPOLLIN, shard->flush_timer.get()))
+                {
+                    Stop();
+                    return false;
+                }
+            }
+        }
 
-        if (smart_socket_.GetRawSocket() != kSocketError)
+        for (auto& listener : listeners_)
         {
-            stopped_ = false;
-            worker_thread_ =
-                std::thread(&SocketServer::Routine, this, client_status_cb, server_data_received_cb);
-            ret = true;
+            Reactor& reactor = shards_[listener->shard]->reactor;
+
+            if (!listener->retry_timer.Open() ||
+                !reactor.Add(listener->retry_timer.GetFd(), EPOLLIN, &listener->retry_timer) ||
+                !reactor.Add(listener->smart_socket.GetRawSocket(), EPOLLIN, listener.get()))
+            {
+                Stop();
+                return false;
+            }
         }
+#else
+        worker_thread_ = std::thread(&SocketServer::Routine, this);
+#endif
 
-        return ret;
+        return true;
     }
 
     void Stop() override
@@ -137,154 +469,446 @@ public:
         stopped_ = true;
 
 #ifdef __linux__
+        for (auto& shard : shards_)
+        {
+            shard->reactor.Stop();
+            if (shard->flush_timer) shard->flush_timer->Close();
+        }
+
+        for (auto& listener : listeners_) listener->retry_timer.Close();
+
+        // Callbacks still queued run while their clients are connected
+        if (executor_) executor_->Stop();
+
+        clients_.Clear([](const SocketClientHandlerPtr<SocketT>& client) {
+            client->MarkDisconnected();
+            client->outbound_queue_.Close();
+            close(client->socket_);
+        });
+
+        // Accepts again once restarted
+        connection_limit_.Update(clients_);
 #else
-        smart_socket_.ForceClose();
-#endif
+        listeners_[0]->smart_socket.ForceClose();
+
         if (worker_thread_.joinable()) worker_thread_.join();
+
+        if (executor_) executor_->Stop();
+#endif
     }
 
-    std::vector<IClientHandlerPtr> GetClients() override
+    void SetClientWritableCb(ClientWritableCb client_writable_cb) override
+    {
+        client_writable_cb_ = client_writable_cb;
+    }
+
+    void SetConnectionRejectedCb(ConnectionRejectedCb connection_rejected_cb) override
     {
-        std::lock_guard<std::mutex> lk(clients_mtx_);
+        connection_rejected_cb_ = connection_rejected_cb;
+    }
 
+    std::vector<IClientHandlerPtr> GetClients() override
+    {
         std::vector<IClientHandlerPtr> clients;
 
-        std::transform(clients_.begin(), clients_.end(), std::back_inserter(clients), [](auto& kv) {
-            return kv.second;
-        });
+        GetClients(clients);
 
         return clients;
     }
 
-    IClientHandlerPtr GetClient(const std::string& id) override
+    void GetClients(std::vector<IClientHandlerPtr>& clients) override
     {
-        SOCKET socket;
-        IClientHandlerPtr client = nullptr;
+        clients.clear();
 
-        try
-        {
-            socket = static_cast<int>(std::stoi(id));
+        clients_.ForEach(
+            [&](const SocketClientHandlerPtr<SocketT>& client) { clients.emplace_back(client); });
+    }
 
-            client = GetClient(socket);
-        }
-        catch (...)
+    using IServer::GetClient;
+
+    IClientHandlerPtr GetClient(ClientId id) override
+    {
+        return clients_.Find(id);
+    }
+
+    PollStats GetPollStats() override
+    {
+        PollStats stats;
+#ifdef __linux__
+        for (auto& shard : shards_) shard->reactor.AddPollStats(stats);
+#endif
+        return stats;
+    }
+
+    ExecutorStats GetExecutorStats() override
+    {
+        return executor_ ? executor_->GetStats() : ExecutorStats();
+    }
+
+    BroadcastResult Broadcast(DataView data, ClientFilter filter) override
+    {
+        BroadcastResult result;
+
+        auto payload = MakeSharedFrame(data, framing_.enabled ? framing_.max_frame_size : 0);
+        if (!payload) return result;
+
+        clients_.ForEach([&](const SocketClientHandlerPtr<SocketT>& client) {
+            if (!filter || filter(*client)) client->SendShared(payload, result);
+        });
+
+        return result;
+    }
+
+    BroadcastResult Broadcast(DataView data, const std::vector<ClientId>& ids) override
+    {
+        BroadcastResult result;
+
+        auto payload = MakeSharedFrame(data, framing_.enabled ? framing_.max_frame_size : 0);
+        if (!payload) return result;
+
+        for (ClientId id : ids)
         {
+            auto client = clients_.Find(id);
+
+            if (client)
+                client->SendShared(payload, result);
+            else
+                ++result.skipped;
         }
 
-        return client;
+        return result;
     }
 
 private:
+    //
+    // Reactor and what its thread uses, only this thread reads from the clients given to it
+    //
+    struct Shard
+    {
+#ifdef __linux__
+        Shard(size_t max_events, const BusyPollConfig& busy_poll)
+            : reactor{max_events, busy_poll}
+        {
+        }
+
+        Reactor reactor;
+        BufferPoolPtr receive_pool; // NUMA local share of the pool, empty when not split
+        Buffer receive_buffer; // shared by all clients of this reactor
+        std::unique_ptr<FlushTimer> flush_timer; // write coalescing only
+#endif
+    };
+
+    struct Listener
 #ifdef __linux__
-    void Routine(ClientStatusCb client_status_cb, ServerDataReceivedCb server_data_received_cb)
+        : public IReactorHandler
+#endif
     {
-        int epoll_fd = epoll_create1(0);
-        if (epoll_fd == -1)
+        template <class... Args>
+        Listener(SocketServer* server, size_t shard, const Args&... args)
+            : smart_socket{args...}
+            , server{server}
+            , shard{shard}
+#ifdef __linux__
+            , retry_timer{
+                  std::chrono::milliseconds(kAcceptRetryDelay_ms),
+                  [this](SOCKET) { this->server->ResumeAccepting(*this); }}
+#endif
+        {
+        }
+
+#ifdef __linux__
+        void HandleEvents(uint32_t events) override
         {
-            // Handle error
-            stopped_ = true;
+            UNUSED(events);
+            server->Accept(*this);
         }
+#endif
 
-        SOCKET server_socket = smart_socket_.GetRawSocket();
-        epoll_event server_event;
-        server_event.data.fd = server_socket;
-        server_event.events = EPOLLIN;
-        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &server_event);
-        constexpr int MAX_EVENTS = 10; // TODO: why?
-        constexpr int STOP_HANDLE_TIMEOUT_MS = 500;
-        std::vector<epoll_event> events(MAX_EVENTS);
+        SmartSocket<Server, SocketT> smart_socket;
+        SocketServer* server;
+        const size_t shard;
+#ifdef __linux__
+        FlushTimer retry_timer; // resumes accepting paused for lack of resources
+#endif
+    };
 
-        while (!stopped_)
+#ifdef __linux__
+    //
+    // Level-triggered listener: takes every pending connection, whatever is left after a
+    // failure or at the connection limit is reported again once accepting resumes
+    //
+    void Accept(Listener& listener)
+    {
+        while (!stopped_ && !connection_limit_.IsReached())
         {
-            int num_events = epoll_wait(
-                epoll_fd,
-                events.data(),
-                MAX_EVENTS,
-                STOP_HANDLE_TIMEOUT_MS); // if pass __timeout as -1 - no timeout
-            if (num_events == -1)
+            SOCKET client_socket = accept4(
+                listener.smart_socket.GetRawSocket(),
+                nullptr,
+                nullptr,
+                SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (client_socket != kSocketError)
             {
-                // Handle error
-                break;
+                AddAccepted(listener, client_socket);
             }
-            else if (num_events == 0)
+            else if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
             {
-                // Timeout occurred, no events - we use it to handle stop request
+                continue; // the peer may have given up meanwhile, the next one is still there
             }
+            else
+            {
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+                    PauseAccepting(listener);
+
+                return; // EAGAIN: all taken
+            }
+        }
+    }
 
-            for (int i = 0; i < num_events; ++i)
+    //
+    // Otherwise the listener stays readable and every round fails again the same way
+    //
+    void PauseAccepting(Listener& listener)
+    {
+        shards_[listener.shard]->reactor.Modify(
+            listener.smart_socket.GetRawSocket(), 0, &listener);
+        listener.retry_timer.Schedule(listener.smart_socket.GetRawSocket());
+
+        if (connection_rejected_cb_) connection_rejected_cb_(RejectReason::kOutOfResources);
+    }
+
+    void ResumeAccepting(Listener& listener)
+    {
+        // Left off while the connection limit holds, it resumes all listeners once lifted
+        if (connection_limit_.IsReached()) return;
+
+        shards_[listener.shard]->reactor.Modify(
+            listener.smart_socket.GetRawSocket(), EPOLLIN, &listener);
+    }
+
+    //
+    // Called by the connection limit, from whichever I/O thread added or removed the client.
+    // Paused listeners are not reported, so pending connections wait in the backlog.
+    //
+    void SetAccepting(bool accepting)
+    {
+        uint32_t events = accepting ? static_cast<uint32_t>(EPOLLIN) : 0;
+
+        for (auto& listener : listeners_)
+        {
+            shards_[listener->shard]->reactor.Modify(
+                listener->smart_socket.GetRawSocket(), events, listener.get());
+        }
+    }
+
+    void AddAccepted(Listener& listener, SOCKET client_socket)
+    {
+        //
+        // SO_REUSEPORT listeners feed their own reactor,
+        // the only UNIX socket listener hands clients off round-robin
+        //
+        size_t shard = listener.shard;
+        if (listeners_.size() != shards_.size()) shard = next_shard_++ % shards_.size();
+
+        ApplySocketOptions(client_socket, accepted_options_, SocketT::kTcp);
+
+        auto client = AddClient(client_socket, shard, admission_.max_connections);
+
+        if (!client)
+        {
+            close(client_socket);
+
+            //
+            // Accepted by another listener's reactor just before the limit paused accepting,
+            // otherwise the socket was out of the client table's range
+            //
+            if (connection_rejected_cb_ && admission_.max_connections > 0 &&
+                clients_.GetCount() >= admission_.max_connections)
+                connection_rejected_cb_(RejectReason::kConnectionLimit);
+            return;
+        }
+
+        if (connection_limit_.Update(clients_) && connection_rejected_cb_)
+            connection_rejected_cb_(RejectReason::kConnectionLimit);
+
+        NotifyStatus(client, true);
+
+        bool added;
+
+        {
+            // The status callback may have paused it already
+            std::lock_guard<std::mutex> lk(client->reading_mtx_);
+            added = shards_[shard]->reactor.Add(client_socket, GetEvents(*client), client.get());
+        }
+
+        // Nothing would ever be reported for it, it goes as if disconnected
+        if (!added) CloseClient(client.get());
+    }
+
+    void HandleClientEvents(SocketClientHandler<SocketT>* handler, uint32_t events)
+    {
+        // Zero-copy completions are reported on the error queue
+        if (events & EPOLLERR) handler->outbound_queue_.ReapZeroCopy();
+
+        if ((events & EPOLLOUT) && !handler->outbound_queue_.Flush())
+        {
+            CloseClient(handler);
+            return;
+        }
+
+        // Handle data from existing clients
+        SOCKET client_socket = handler->socket_;
+
+        //
+        // Edge-triggered mode: the socket has to be drained until EAGAIN,
+        // whatever is left there would wait for the next data from the Client
+        //
+        auto& buffer = shards_[handler->shard_]->receive_buffer;
+        SocketClientHandlerPtr<SocketT> client; // taken on the first read only
+        ReadBudget budget(read_budget_);
+
+        // Frames held back by a pause go first, resuming reports the socket again
+        if (handler->unread_ && !handler->reading_paused_)
+        {
+            if (!server_handler_ || executor_) client = handler->shared_from_this();
+            Buffer unread = std::move(handler->unread_);
+
+            if (!DeliverReceived(*handler, client, unread))
             {
-                int client_socket;
+                CloseClient(handler);
+                return;
+            }
+        }
 
-                if (events[i].data.fd == server_socket)
-                {
-                    // New client connected
-                    client_socket = accept(server_socket, nullptr, nullptr);
-                    epoll_event client_event;
-                    client_event.data.fd = client_socket;
-                    client_event.events = EPOLLIN | EPOLLET; // Edge-triggered mode
-                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &client_event);
+        // Paused data waits in the socket, EPOLL_CTL_MOD reports it again once resumed
+        while (!handler->reading_paused_)
+        {
+            if (budget.IsExhausted())
+            {
+                // The rest is read on a later round, after the other clients had their turn
+                RearmReading(handler);
+                break;
+            }
 
-                    auto client = AddClient(client_socket);
+            // a buffer still retained by a callback can't be reused, take a fresh one
+            if (buffer.UseCount() != 1) buffer = GetReceivePool(handler->shard_)->Acquire();
 
-                    if (client && client_status_cb) client_status_cb(client, true);
-                }
-                else
+            ssize_t bytes_read =
+                read(client_socket, BufferPool::MutableData(buffer), BufferPool::Capacity(buffer));
+            if (bytes_read > 0)
+            {
+                // Handle received data
+                size_t messages = 1;
+
+                if (ReceivesData())
                 {
-                    // Handle data from existing clients
-                    client_socket = events[i].data.fd;
-                    std::vector<uint8_t> buffer(kDataBufferSize);
+                    // Borrowed by the handler interface, otherwise taken once for all the reads
+                    if (!client && (!server_handler_ || executor_))
+                        client = handler->shared_from_this();
+                    BufferPool::SetSize(buffer, bytes_read);
 
-                    int bytes_read = read(client_socket, buffer.data(), buffer.size());
-                    if (bytes_read == 0)
+                    if (!DeliverReceived(*handler, client, buffer, &messages))
                     {
-                        // Client disconnected
-                        auto client = GetClient(client_socket);
-
-                        if (client)
-                        {
-                            client->connected_ = false;
-                            RemoveClient(client_socket);
-                            if (client_status_cb) client_status_cb(client, false);
-                        }
-
-                        // Handle the disconnection
-                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_socket, nullptr);
-                        close(client_socket);
-                    }
-                    else if (bytes_read < 0)
-                    {
-                        // Error occurred
-                    }
-                    else
-                    {
-                        // Handle received data
-                        if (server_data_received_cb)
-                        {
-                            auto client = GetClient(client_socket);
-                            buffer.resize(bytes_read);
-                            server_data_received_cb(client, buffer);
-                        }
+                        CloseClient(handler);
+                        return;
                     }
                 }
+
+                budget.Spend(static_cast<size_t>(bytes_read), messages);
+            }
+            else if (bytes_read == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            else
+            {
+                // Client disconnected or connection is broken
+                CloseClient(handler);
+                return;
             }
         }
 
-        if (epoll_fd != -1) close(epoll_fd);
+        // Whatever the callbacks sent in reply goes out in one batch
+        if (write_coalescing_.max_bytes > 0 && !handler->outbound_queue_.Flush())
+            CloseClient(handler);
     }
-#else
-    void Routine(ClientStatusCb client_status_cb, ServerDataReceivedCb server_data_received_cb)
+
+    // Edge-triggered mode, EPOLLOUT edges flush the outbound queue
+    static uint32_t GetEvents(SocketClientHandler<SocketT>& handler)
     {
-        client_status_cb_ = client_status_cb;
-        server_data_received_cb_ = server_data_received_cb;
+        return handler.reading_paused_ ? EPOLLOUT | EPOLLET : EPOLLIN | EPOLLOUT | EPOLLET;
+    }
 
+    // Called with the client's reading_mtx_ locked
+    void UpdateReading(SocketClientHandler<SocketT>* handler)
+    {
+        shards_[handler->shard_]->reactor.Modify(handler->socket_, GetEvents(*handler), handler);
+    }
+
+    //
+    // Edge-triggered mode reports a socket with data left only once, EPOLL_CTL_MOD reports it
+    // again and queues it behind the sockets already ready
+    //
+    void RearmReading(SocketClientHandler<SocketT>* handler)
+    {
+        std::lock_guard<std::mutex> lk(handler->reading_mtx_);
+
+        if (handler->connected_) UpdateReading(handler);
+    }
+
+    std::function<void()> MakeScheduleFlush(SOCKET socket, size_t shard)
+    {
+        FlushTimer* flush_timer = shards_[shard]->flush_timer.get();
+
+        if (!flush_timer) return nullptr;
+
+        return [flush_timer, socket]() { flush_timer->Schedule(socket); };
+    }
+
+    void CloseClient(SocketClientHandler<SocketT>* handler)
+    {
+        SOCKET client_socket = handler->socket_;
+        size_t shard = handler->shard_;
+
+        handler->MarkDisconnected();
+
+        // The socket isn't closed yet, so its slot can't hold anybody else
+        auto client = clients_.Remove(client_socket);
+
+        if (client)
+        {
+            connection_limit_.Update(clients_);
+            client->outbound_queue_.Close();
+            NotifyDisconnected(client);
+        }
+
+        // Handle the disconnection
+        shards_[shard]->reactor.Remove(client_socket);
+        close(client_socket);
+    }
+#else
+    void Routine()
+    {
         while (!stopped_)
         {
-            SOCKET client_socket = accept(smart_socket_.GetRawSocket(), nullptr, nullptr);
+            SOCKET client_socket =
+                accept(listeners_[0]->smart_socket.GetRawSocket(), nullptr, nullptr);
             if (client_socket != kSocketError)
             {
-                auto client = AddClient(static_cast<int>(client_socket));
+                auto client = AddClient(static_cast<int>(client_socket), 0);
+
+                // Out of the client table's range
+                if (!client)
+                {
+                    closesocket(client_socket);
+                    continue;
+                }
 
-                if (client && client_status_cb) client_status_cb(client, true);
+                NotifyStatus(client, true);
 
                 //
                 // int WSAAPI WSARecv(
@@ -297,6 +921,8 @@ private:
                 //     [in]      LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine
                 // );
                 //
+                client->PrepareReceive(*receive_pool_);
+
                 SOCKET wsa_recv_sock = client_socket;
                 LPWSABUF wsa_recv_buf = &client->wsa_receive_buf_;
                 LPDWORD wsa_recv_flags = &client->wsa_receive_flags_;
@@ -314,8 +940,8 @@ private:
                 if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
                 {
                     client->connected_ = false;
-                    RemoveClient(static_cast<int>(client_socket));
-                    if (client_status_cb_) client_status_cb_(client, false);
+                    clients_.Remove(client_socket);
+                    NotifyDisconnected(client);
                 }
             }
         }
@@ -333,7 +959,7 @@ private:
             CONTAINING_RECORD(overlapped, SocketClientHandler<SocketT>, wsa_overlapped_);
         SOCKET client_socket = rc->socket_;
 
-        auto client = rc->server_->GetClient(rc->socket_);
+        auto client = rc->server_->clients_.FindBySocket(rc->socket_);
         if (!client) return;
         auto& server = client->server_;
 
@@ -342,18 +968,28 @@ private:
             if (error != 0)
             {
                 client->connected_ = false;
-                server->RemoveClient(client_socket);
-                if (server->client_status_cb_) server->client_status_cb_(client, false);
+                server->clients_.Remove(client_socket);
+                server->NotifyDisconnected(client);
             }
             else
             {
-                if (server->server_data_received_cb_)
+                if (server->ReceivesData())
                 {
-                    client->receive_buffer_.resize(received_bytes);
-                    server->server_data_received_cb_(client, client->receive_buffer_);
-                    client->receive_buffer_.resize(kDataBufferSize);
+                    BufferPool::SetSize(client->receive_buffer_, received_bytes);
+
+                    if (!server->DeliverReceived(*client, client, client->receive_buffer_))
+                    {
+                        // Broken framing, the stream can't be followed any more
+                        client->connected_ = false;
+                        server->clients_.Remove(client_socket);
+                        server->NotifyDisconnected(client);
+                        shutdown(client_socket, SD_BOTH);
+                        return;
+                    }
                 }
 
+                client->PrepareReceive(*server->receive_pool_);
+
                 // next receiving
                 SOCKET wsa_recv_sock = client_socket;
                 LPWSABUF wsa_recv_buf = &client->wsa_receive_buf_;
@@ -372,55 +1008,162 @@ private:
                 if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
                 {
                     client->connected_ = false;
-                    server->RemoveClient(static_cast<int>(client_socket));
-                    if (server->client_status_cb_) server->client_status_cb_(client, false);
+                    server->clients_.Remove(client_socket);
+                    server->NotifyDisconnected(client);
                 }
             }
         }
     }
 #endif
-    SocketClientHandlerPtr<SocketT> GetClient(SOCKET socket)
+    void NotifyWritable(SocketClientHandler<SocketT>* handler, bool writable)
+    {
+        if (client_writable_cb_) client_writable_cb_(handler->shared_from_this(), writable);
+    }
+
+    bool ReceivesData() const { return server_handler_ || server_data_received_cb_; }
+
+    //
+    // Hands received data to the callback, whole frames only with framing on.
+    // Frames left when reading is paused from a callback are kept in the handler's unread_.
+    // messages, if given, is set to the number of callbacks made.
+    // Returns false when the client sent a frame over the limit.
+    // client may be null when the handler interface takes the data inline.
+    //
+    bool DeliverReceived(
+        SocketClientHandler<SocketT>& handler,
+        const SocketClientHandlerPtr<SocketT>& client,
+        const Buffer& data,
+        size_t* messages = nullptr)
+    {
+        if (!handler.frame_decoder_)
+        {
+            Dispatch(handler, client, data);
+            if (messages) *messages = 1;
+            return true;
+        }
+
+        size_t frames = 0;
+
+        bool ok = handler.frame_decoder_->Feed(
+            data,
+            [&](const Buffer& frame) {
+                Dispatch(handler, client, frame);
+                ++frames;
+                return !handler.reading_paused_;
+            },
+            &handler.unread_);
+
+        if (messages) *messages = frames;
+
+        return ok;
+    }
+
+    //
+    // Data callback, on the executor if there is one. The task keeps the buffer,
+    // the reactor reads into a fresh one meanwhile.
+    //
+    void Dispatch(
+        SocketClientHandler<SocketT>& handler,
+        const SocketClientHandlerPtr<SocketT>& client,
+        const Buffer& data)
     {
-        std::lock_guard<std::mutex> lk(clients_mtx_);
+        if (!executor_)
+        {
+            NotifyReceived(handler, client, data);
+            return;
+        }
 
-        auto it = clients_.find(socket);
+        executor_->Post(
+            client->strand_, [this, client, data]() { NotifyReceived(*client, client, data); });
+    }
 
-        if (it != clients_.end())
-            return (*it).second;
+    void NotifyReceived(
+        SocketClientHandler<SocketT>& handler,
+        const SocketClientHandlerPtr<SocketT>& client,
+        const Buffer& data)
+    {
+        if (server_handler_)
+            server_handler_->OnDataReceived(handler, data);
         else
-            return nullptr;
+            server_data_received_cb_(client, data);
     }
 
-    SocketClientHandlerPtr<SocketT> AddClient(SOCKET socket)
+    void NotifyStatus(const SocketClientHandlerPtr<SocketT>& client, bool connected)
     {
-        std::lock_guard<std::mutex> lk(clients_mtx_);
+        if (server_handler_)
+            server_handler_->OnClientStatus(*client, connected);
+        else if (client_status_cb_)
+            client_status_cb_(client, connected);
+    }
 
-        auto client = std::make_shared<SocketClientHandler<SocketT>>(socket, this);
+    // After the data callbacks still queued for the client
+    void NotifyDisconnected(const SocketClientHandlerPtr<SocketT>& client)
+    {
+        if (!server_handler_ && !client_status_cb_) return;
 
-        auto emplace_res = clients_.emplace(socket, client);
+        if (!executor_)
+        {
+            NotifyStatus(client, false);
+            return;
+        }
 
-        if (emplace_res.second)
-            return client;
-        else
-            return nullptr;
+        executor_->Post(client->strand_, [this, client]() { NotifyStatus(client, false); });
     }
 
-    void RemoveClient(SOCKET socket)
+    BufferPool* GetReceivePool(size_t shard)
     {
-        std::lock_guard<std::mutex> lk(clients_mtx_);
-        clients_.erase(socket);
+#ifdef __linux__
+        if (shards_[shard]->receive_pool) return shards_[shard]->receive_pool.get();
+#else
+        UNUSED(shard);
+#endif
+        return receive_pool_.get();
+    }
+
+    // limit: clients served at most, 0 for no limit
+    SocketClientHandlerPtr<SocketT> AddClient(SOCKET socket, size_t shard, size_t limit = 0)
+    {
+        return clients_.Add(
+            socket,
+            [&](ClientId id) {
+                return std::allocate_shared<SocketClientHandler<SocketT>>(
+                    ResourceAllocator<SocketClientHandler<SocketT>>(memory_resource_),
+                    socket,
+                    id,
+                    this,
+                    shard);
+            },
+            limit);
     }
 
-    SmartSocket<Server, SocketT> smart_socket_;
+    MemoryResource* const memory_resource_; // nullptr for the global heap
+    BufferPoolPtr receive_pool_;
+    const WriteCoalescingConfig write_coalescing_;
+    const size_t zero_copy_min_bytes_;
+    const FramingConfig framing_;
+    const WatermarkConfig send_watermarks_;
+    const ReadBudgetConfig read_budget_;
+    const AdmissionConfig admission_;
+    SocketOptions accepted_options_;
+    const ThreadConfig io_threads_;
+    std::unique_ptr<CallbackExecutor> executor_; // data callbacks run inline without one
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::unique_ptr<Listener>> listeners_;
+    ClientTable<SocketClientHandler<SocketT>> clients_;
     std::atomic_bool stopped_;
-    std::map<SOCKET, SocketClientHandlerPtr<SocketT>> clients_;
-    std::mutex clients_mtx_;
-    std::thread worker_thread_;
+    ClientStatusCb client_status_cb_;
+    ServerBufferReceivedCb server_data_received_cb_;
+    IServerHandler* server_handler_ = nullptr; // instead of the two above
+    ClientWritableCb client_writable_cb_;
+    ConnectionRejectedCb connection_rejected_cb_;
 #ifdef __linux__
+    std::atomic_size_t next_shard_{0};
+    ConnectionLimit connection_limit_; // AdmissionConfig::max_connections
 #else
-    ClientStatusCb client_status_cb_;
-    ServerDataReceivedCb server_data_received_cb_;
+    std::thread worker_thread_;
 #endif
+
+    friend class SocketClientHandler<SocketT>;
 };
 
 } // namespace libsercli
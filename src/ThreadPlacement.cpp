@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include "ThreadPlacement.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+#include "Macros.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+#ifdef __linux__
+// Thread names are at most 16 bytes including the terminating null
+constexpr size_t kMaxThreadName = 15;
+
+namespace {
+
+// Looks for the nodeN entry sysfs lists for every CPU of a NUMA system
+int GetNumaNode(int cpu)
+{
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return -1;
+
+    int node = -1;
+
+    while (dirent* entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] != '\0')
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(dir);
+
+    return node;
+}
+
+} // namespace
+#endif
+
+ThreadPlacement
+GetThreadPlacement(const ThreadConfig& config, const char* default_name, size_t index)
+{
+    ThreadPlacement placement;
+
+    placement.name = (config.name.empty() ? default_name : config.name) + std::to_string(index);
+    if (!config.cpus.empty()) placement.cpu = config.cpus[index % config.cpus.size()];
+
+    return placement;
+}
+
+void ApplyThreadPlacement(const ThreadPlacement& placement)
+{
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), placement.name.substr(0, kMaxThreadName).c_str());
+
+    if (placement.cpu >= 0 && placement.cpu < CPU_SETSIZE)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(placement.cpu, &cpus);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#else
+    UNUSED(placement);
+#endif
+}
+
+int GetBufferNode(const ThreadConfig& config, size_t index)
+{
+#ifdef __linux__
+    if (!config.numa_local_buffers || config.cpus.empty()) return -1;
+
+    return GetNumaNode(config.cpus[index % config.cpus.size()]);
+#else
+    UNUSED(config);
+    UNUSED(index);
+    return -1;
+#endif
+}
+
+} // namespace libsercli
+} // namespace nkhlab
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#pragma once
+
+#include <string>
+
+#include "libsercli/ThreadConfig.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Name and CPU of one I/O thread
+//
+struct ThreadPlacement
+{
+    std::string name;
+    int cpu = -1; // not pinned
+};
+
+// default_name: used when the config has no name
+ThreadPlacement
+GetThreadPlacement(const ThreadConfig& config, const char* default_name, size_t index);
+
+//
+// Names the calling thread and pins it to its CPU, to be called first thing on a new thread.
+// Best effort: a CPU the process may not use leaves the thread where it is.
+//
+void ApplyThreadPlacement(const ThreadPlacement& placement);
+
+// NUMA node receive buffers of thread index are allocated on, -1 for no preference
+int GetBufferNode(const ThreadConfig& config, size_t index);
+
+} // namespace libsercli
+} // namespace nkhlab
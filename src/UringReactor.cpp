@@ -0,0 +1,945 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#ifdef __linux__
+
+#include "UringReactor.h"
+
+#include <sys/eventfd.h>
+#include <sys/utsname.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+namespace nkhlab {
+namespace libsercli {
+
+constexpr unsigned kRingEntries = 256;
+constexpr uint16_t kBufferGroup = 0;
+constexpr unsigned kMaxBuffers = 32768; // largest buffer ring
+
+namespace {
+
+// Multishot recv came with 6.0, older rings would accept but fail every connection
+bool IsKernelSupported()
+{
+    utsname name;
+    int major = 0;
+
+    if (uname(&name) != 0 || sscanf(name.release, "%d", &major) != 1) return false;
+
+    return major >= 6;
+}
+
+} // namespace
+
+//
+// IsIoUringSupported
+//
+
+bool IsIoUringSupported()
+{
+    if (!IsKernelSupported()) return false;
+
+    // Containers may deny io_uring_setup() whatever the kernel
+    IoUring ring;
+
+    return ring.Init(1);
+}
+
+//
+// UringConnection
+//
+
+UringConnection::UringConnection(
+    SOCKET socket,
+    UringReactor* reactor,
+    bool owns_socket,
+    MemoryResource* resource)
+    : socket_{socket}
+    , reactor_{reactor}
+    , owns_socket_{owns_socket}
+    , allocator_{resource}
+    , open_{true}
+    , messages_{allocator_}
+    , send_scheduled_{false}
+    , queued_bytes_{0}
+    , reading_paused_{false}
+    , sending_{0}
+    , send_msg_{}
+    , ops_{0}
+    , closing_{false}
+    , recv_armed_{false}
+    , held_{allocator_}
+    , peer_closed_{false}
+{
+}
+
+SOCKET UringConnection::GetSocket() const
+{
+    return socket_;
+}
+
+bool UringConnection::IsOpen() const
+{
+    return open_;
+}
+
+bool UringConnection::Send(const DataView* data, size_t count, SendCompletedCb completed_cb)
+{
+    return Send(data, count, std::move(completed_cb), false);
+}
+
+bool UringConnection::SendBorrowed(
+    const DataView* data,
+    size_t count,
+    SendCompletedCb completed_cb)
+{
+    return Send(data, count, std::move(completed_cb), true);
+}
+
+bool UringConnection::Send(
+    const DataView* data,
+    size_t count,
+    SendCompletedCb completed_cb,
+    bool borrowed)
+{
+    bool schedule = false;
+    bool writable_changed = false;
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+
+        if (!open_) return false;
+
+        for (size_t i = 0; i < count; ++i) queued_bytes_ += data[i].size();
+        writable_changed = watermarks_.Update(queued_bytes_);
+
+        if (borrowed)
+        {
+            // Queued back to back under the lock, so the parts never interleave with other sends
+            for (size_t i = 0; i < count; ++i)
+            {
+                messages_.push_back(Message{Bytes(allocator_), data[i], 0, nullptr});
+            }
+
+            if (count > 0) messages_.back().completed_cb = std::move(completed_cb);
+        }
+        else
+        {
+            // One contiguous message, so its parts never interleave with other sends
+            Message message{Bytes(allocator_), DataView(), 0, std::move(completed_cb)};
+
+            size_t size = 0;
+            for (size_t i = 0; i < count; ++i) size += data[i].size();
+
+            message.data.reserve(size);
+            for (size_t i = 0; i < count; ++i)
+                message.data.insert(message.data.end(), data[i].begin(), data[i].end());
+
+            messages_.push_back(std::move(message));
+            messages_.back().view =
+                DataView(messages_.back().data.data(), messages_.back().data.size());
+        }
+
+        schedule = !send_scheduled_;
+        send_scheduled_ = true;
+    }
+
+    if (writable_changed && writable_cb_) writable_cb_(false);
+    if (schedule) reactor_->ScheduleSend(shared_from_this());
+
+    return true;
+}
+
+size_t UringConnection::GetQueuedCount()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    return messages_.size();
+}
+
+void UringConnection::SetWatermarks(
+    const WatermarkConfig& config,
+    std::function<void(bool writable)> writable_cb)
+{
+    watermarks_ = Watermarks(config);
+    writable_cb_ = std::move(writable_cb);
+}
+
+bool UringConnection::IsWritable()
+{
+    std::lock_guard<std::mutex> lk(messages_mtx_);
+    return watermarks_.IsWritable();
+}
+
+void UringConnection::PauseReading()
+{
+    reading_paused_ = true;
+    reactor_->ScheduleRecv(shared_from_this());
+}
+
+void UringConnection::ResumeReading()
+{
+    reading_paused_ = false;
+    reactor_->ScheduleRecv(shared_from_this());
+}
+
+bool UringConnection::IsReadingPaused() const
+{
+    return reading_paused_;
+}
+
+void UringConnection::HoldUnread(Buffer unread)
+{
+    held_.push_front(std::move(unread));
+}
+
+void UringConnection::FailQueued()
+{
+    Messages messages(allocator_);
+
+    {
+        std::lock_guard<std::mutex> lk(messages_mtx_);
+        messages.swap(messages_);
+        queued_bytes_ = 0;
+        watermarks_.Reset(); // nothing is reported for a closed connection
+    }
+
+    for (auto& message : messages)
+    {
+        if (message.completed_cb) message.completed_cb(false);
+    }
+}
+
+//
+// UringReactor
+//
+
+UringReactor::UringReactor(
+    IUringHandler* handler,
+    BufferPool* pool,
+    size_t buffers,
+    const BusyPollConfig& busy_poll)
+    : handler_{handler}
+    , pool_{pool}
+    , buffer_count_{
+          static_cast<unsigned>(std::min<size_t>(std::max<size_t>(buffers, 1), kMaxBuffers))}
+    , spin_time_{busy_poll.spin_time}
+    , stop_requested_{false}
+    , wake_pending_{false}
+    , accepting_{true}
+    , accepting_changed_{false}
+    , wake_fd_{eventfd(0, EFD_CLOEXEC)} // lives as long as the reactor, any thread may wake it
+    , wake_value_{0}
+    , accept_retry_delay_{0, kAcceptRetryDelay_ms * 1000000LL}
+    , ops_{0}
+{
+}
+
+UringReactor::~UringReactor()
+{
+    Stop();
+
+    if (wake_fd_ != -1) close(wake_fd_);
+}
+
+void UringReactor::Listen(SOCKET listener)
+{
+    listeners_.push_back(listener);
+}
+
+bool UringReactor::Start(const ThreadPlacement& placement)
+{
+    if (worker_thread_.joinable()) return true;
+
+    stop_requested_ = false;
+    placement_ = placement;
+
+    // The ring belongs to the thread that creates it
+    std::promise<bool> ready;
+    auto ready_future = ready.get_future();
+
+    worker_thread_ = std::thread(&UringReactor::Routine, this, &ready);
+
+    if (!ready_future.get())
+    {
+        worker_thread_.join();
+        return false;
+    }
+
+    return true;
+}
+
+void UringReactor::Stop()
+{
+    if (!worker_thread_.joinable()) return;
+
+    stop_requested_ = true;
+    Wake();
+
+    worker_thread_.join();
+}
+
+void UringReactor::Add(UringConnectionPtr connection)
+{
+    Schedule(adds_, std::move(connection));
+}
+
+void UringReactor::SetAccepting(bool accepting)
+{
+    if (listeners_.empty()) return;
+
+    accepting_ = accepting;
+
+    bool wake = false;
+
+    {
+        std::lock_guard<std::mutex> lk(scheduled_mtx_);
+        accepting_changed_ = true;
+
+        if (!wake_pending_ && std::this_thread::get_id() != worker_id_)
+        {
+            wake_pending_ = true;
+            wake = true;
+        }
+    }
+
+    if (wake) Wake();
+}
+
+void UringReactor::AddPollStats(PollStats& stats) const
+{
+    poll_counters_.AddTo(stats);
+}
+
+void UringReactor::ScheduleSend(UringConnectionPtr connection)
+{
+    Schedule(sends_, std::move(connection));
+}
+
+void UringReactor::ScheduleRecv(UringConnectionPtr connection)
+{
+    Schedule(recvs_, std::move(connection));
+}
+
+void UringReactor::Schedule(std::vector<UringConnectionPtr>& list, UringConnectionPtr connection)
+{
+    bool wake = false;
+
+    {
+        std::lock_guard<std::mutex> lk(scheduled_mtx_);
+        list.push_back(std::move(connection));
+
+        // The reactor thread picks it up before it waits again anyway
+        if (!wake_pending_ && std::this_thread::get_id() != worker_id_)
+        {
+            wake_pending_ = true;
+            wake = true;
+        }
+    }
+
+    if (wake) Wake();
+}
+
+void UringReactor::Wake()
+{
+    eventfd_write(wake_fd_, 1);
+}
+
+void UringReactor::Routine(std::promise<bool>* ready)
+{
+    // Before Setup(), the ring and the buffers it provides are allocated on this CPU's node
+    ApplyThreadPlacement(placement_);
+
+    {
+        std::lock_guard<std::mutex> lk(scheduled_mtx_);
+        worker_id_ = std::this_thread::get_id();
+    }
+
+    bool ok = Setup();
+
+    if (!ok) Teardown();
+
+    ready->set_value(ok);
+    if (!ok) return;
+
+    bool stopping = false;
+
+    for (;;)
+    {
+        if (stop_requested_ && !stopping)
+        {
+            stopping = true;
+            PrepareCancelAll();
+        }
+
+        if (!stopping)
+        {
+            bool accepting_changed;
+
+            {
+                std::lock_guard<std::mutex> lk(scheduled_mtx_);
+                taken_adds_.swap(adds_);
+                taken_sends_.swap(sends_);
+                taken_recvs_.swap(recvs_);
+                accepting_changed = accepting_changed_;
+                accepting_changed_ = false;
+                wake_pending_ = false;
+            }
+
+            if (accepting_changed) UpdateAccepting();
+
+            for (auto& connection : taken_adds_)
+            {
+                UringConnection* raw = connection.get();
+
+                connections_.emplace(raw, std::move(connection));
+                if (!raw->reading_paused_) PrepareRecv(raw);
+            }
+
+            for (auto& connection : taken_sends_) PrepareSend(connection.get());
+            for (auto& connection : taken_recvs_) UpdateRecv(connection.get());
+
+            taken_adds_.clear();
+            taken_sends_.clear();
+            taken_recvs_.clear();
+        }
+        else if (ops_ == 0)
+        {
+            break;
+        }
+
+        int ret = SubmitAndWait();
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) break;
+
+        while (io_uring_cqe* cqe = ring_.PeekCqe())
+        {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+
+            ring_.SeenCqe();
+            HandleCompletion(user_data, res, flags);
+        }
+    }
+
+    Teardown();
+}
+
+int UringReactor::SubmitAndWait()
+{
+    int ret = 0;
+
+    if (spin_time_.count() > 0)
+    {
+        auto start = PollCounters::Clock::now();
+        auto now = start;
+        bool found;
+
+        do
+        {
+            ret = ring_.SubmitAndPoll();
+            found = ring_.PeekCqe() != nullptr;
+            now = PollCounters::Clock::now();
+        } while (!found && ret >= 0 && !stop_requested_ && now - start < spin_time_);
+
+        poll_counters_.AddSpin(now - start, found);
+
+        if (found || ret < 0) return ret;
+    }
+
+    // Sleeps until something completes
+    auto start = PollCounters::Clock::now();
+
+    ret = ring_.SubmitAndWait(1);
+
+    poll_counters_.AddIdle(PollCounters::Clock::now() - start, ring_.PeekCqe() != nullptr);
+
+    return ret;
+}
+
+bool UringReactor::Setup()
+{
+    ops_ = 0;
+
+    if (wake_fd_ == -1 || !IsKernelSupported() || !ring_.Init(kRingEntries)) return false;
+
+    unsigned ring_entries = 1;
+    while (ring_entries < buffer_count_) ring_entries <<= 1;
+
+    if (!ring_.InitBufferRing(ring_entries, kBufferGroup)) return false;
+
+    buffers_.resize(buffer_count_);
+
+    for (unsigned i = 0; i < buffer_count_; ++i)
+    {
+        buffers_[i] = pool_->Acquire();
+        Provide(static_cast<uint16_t>(i));
+    }
+
+    PrepareWake();
+
+    accept_armed_.assign(listeners_.size(), false);
+
+    for (size_t i = 0; i < listeners_.size(); ++i)
+    {
+        if (accepting_) PrepareAccept(i);
+    }
+
+    return true;
+}
+
+void UringReactor::Teardown()
+{
+    // Nothing is in flight any more, whatever the kernel referenced can go
+    for (auto& kv : connections_)
+    {
+        UringConnection* connection = kv.first;
+
+        connection->open_ = false;
+        connection->FailQueued();
+        if (connection->owns_socket_) close(connection->socket_);
+    }
+    connections_.clear();
+
+    {
+        std::lock_guard<std::mutex> lk(scheduled_mtx_);
+
+        for (auto& connection : adds_)
+        {
+            connection->open_ = false;
+            connection->FailQueued();
+            if (connection->owns_socket_) close(connection->socket_);
+        }
+
+        adds_.clear();
+        sends_.clear();
+        worker_id_ = std::thread::id();
+        wake_pending_ = false;
+    }
+
+    // Also takes back the buffers the kernel still holds
+    ring_.Close();
+    buffers_.clear();
+}
+
+io_uring_sqe* UringReactor::NextSqe()
+{
+    io_uring_sqe* sqe = ring_.GetSqe();
+
+    if (!sqe)
+    {
+        // Submission queue is full, hand it over to the kernel to make room
+        ring_.SubmitAndWait(0);
+        sqe = ring_.GetSqe();
+    }
+
+    return sqe;
+}
+
+void UringReactor::PrepareAccept(size_t listener)
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listeners_[listener];
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = (listener << 3) | kAccept;
+
+    ++ops_;
+    accept_armed_[listener] = true;
+}
+
+void UringReactor::PrepareAcceptRetry(size_t listener)
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&accept_retry_delay_);
+    sqe->len = 1;
+    sqe->user_data = (listener << 3) | kAcceptRetry;
+
+    ++ops_;
+}
+
+void UringReactor::PrepareRecv(UringConnection* connection)
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection->socket_;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = reinterpret_cast<uint64_t>(connection) | kRecv;
+
+    ++ops_;
+    ++connection->ops_;
+    connection->recv_armed_ = true;
+}
+
+void UringReactor::PrepareSend(UringConnection* connection)
+{
+    if (connection->closing_) return;
+
+    size_t iov_count = 0;
+
+    {
+        std::lock_guard<std::mutex> lk(connection->messages_mtx_);
+
+        // One send in flight per connection keeps the order
+        if (connection->sending_ > 0) return;
+
+        if (connection->messages_.empty())
+        {
+            connection->send_scheduled_ = false;
+            return;
+        }
+
+        // The deque never moves its elements, the kernel may read them after unlocking
+        for (auto& message : connection->messages_)
+        {
+            if (iov_count == kMaxIov) break;
+
+            connection->send_iov_[iov_count].iov_base =
+                const_cast<uint8_t*>(message.view.data()) + message.offset;
+            connection->send_iov_[iov_count].iov_len = message.view.size() - message.offset;
+            ++iov_count;
+        }
+
+        connection->sending_ = iov_count;
+    }
+
+    connection->send_msg_ = {};
+    connection->send_msg_.msg_iov = connection->send_iov_;
+    connection->send_msg_.msg_iovlen = iov_count;
+
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection->socket_;
+    sqe->addr = reinterpret_cast<uint64_t>(&connection->send_msg_);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = reinterpret_cast<uint64_t>(connection) | kSend;
+
+    ++ops_;
+    ++connection->ops_;
+}
+
+void UringReactor::PrepareWake()
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wake_value_);
+    sqe->len = sizeof(wake_value_);
+    sqe->user_data = kWake;
+
+    ++ops_;
+}
+
+void UringReactor::PrepareCancelAll()
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = kCancel;
+
+    ++ops_;
+}
+
+void UringReactor::PrepareCancelRecv(UringConnection* connection)
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(connection) | kRecv;
+    sqe->user_data = kCancel;
+
+    ++ops_;
+}
+
+void UringReactor::PrepareCancelAccept(size_t listener)
+{
+    io_uring_sqe* sqe = NextSqe();
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (listener << 3) | kAccept;
+    sqe->user_data = kCancel;
+
+    ++ops_;
+}
+
+void UringReactor::Provide(uint16_t id)
+{
+    Buffer& buffer = buffers_[id];
+
+    ring_.ProvideBuffer(
+        BufferPool::MutableData(buffer), static_cast<uint32_t>(BufferPool::Capacity(buffer)), id);
+}
+
+void UringReactor::HandleCompletion(uint64_t user_data, int res, uint32_t flags)
+{
+    // Multishot requests stay armed while the kernel says there is more
+    if (!(flags & IORING_CQE_F_MORE)) --ops_;
+
+    switch (user_data & kOpMask)
+    {
+    case kAccept:
+        HandleAccept(user_data >> 3, res, flags);
+        break;
+
+    case kRecv:
+    case kSend:
+    {
+        auto connection = reinterpret_cast<UringConnection*>(user_data & ~uint64_t(kOpMask));
+
+        if ((user_data & kOpMask) == kRecv)
+            HandleRecv(connection, res, flags);
+        else
+            HandleSend(connection, res);
+
+        //
+        // Counted down only now, so a connection closed by the handlers stays until they return.
+        // Last request of a closed connection is done, nothing references it any more.
+        //
+        if (!(flags & IORING_CQE_F_MORE)) --connection->ops_;
+
+        if (connection->closing_ && connection->ops_ == 0) ReleaseConnection(connection);
+        break;
+    }
+
+    case kWake:
+        if (!stop_requested_) PrepareWake();
+        break;
+
+    case kAcceptRetry:
+        // Accepting may have been paused meanwhile, or resumed and armed already
+        if (!stop_requested_ && accepting_ && !accept_armed_[user_data >> 3])
+            PrepareAccept(user_data >> 3);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void UringReactor::HandleAccept(size_t listener, int res, uint32_t flags)
+{
+    if (res >= 0)
+    {
+        if (stop_requested_)
+            close(res);
+        else
+            handler_->HandleAccept(listeners_[listener], res);
+    }
+
+    if (flags & IORING_CQE_F_MORE) return;
+
+    accept_armed_[listener] = false;
+
+    if (stop_requested_) return;
+
+    if (res == -EMFILE || res == -ENFILE || res == -ENOBUFS || res == -ENOMEM)
+    {
+        // Accepting again at once would fail the same way in every round
+        PrepareAcceptRetry(listener);
+        handler_->HandleAcceptPaused(listeners_[listener]);
+    }
+    else if (accepting_)
+    {
+        // Also after a cancel, when accepting was resumed before it completed
+        PrepareAccept(listener);
+    }
+}
+
+void UringReactor::UpdateAccepting()
+{
+    for (size_t i = 0; i < listeners_.size(); ++i)
+    {
+        if (accepting_ && !accept_armed_[i])
+            PrepareAccept(i);
+        else if (!accepting_ && accept_armed_[i])
+            PrepareCancelAccept(i);
+    }
+}
+
+void UringReactor::HandleRecv(UringConnection* connection, int res, uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_MORE)) connection->recv_armed_ = false;
+
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        Buffer& buffer = buffers_[id];
+
+        if (res > 0 && !connection->closing_)
+        {
+            BufferPool::SetSize(buffer, static_cast<size_t>(res));
+
+            // The recv is being cancelled, keep the order with what is held already
+            if (connection->reading_paused_ || !connection->held_.empty())
+                connection->held_.push_back(buffer);
+            else if (!handler_->HandleReceive(*connection, buffer))
+                CloseConnection(connection);
+        }
+
+        // a buffer still retained by a callback can't be reused, provide a fresh one
+        if (buffer.UseCount() != 1) buffer = pool_->Acquire();
+
+        Provide(id);
+    }
+
+    if (res > 0 || res == -ENOBUFS || res == -ECANCELED)
+    {
+        //
+        // ENOBUFS: all buffers were taken, they are provided again with this round.
+        // ECANCELED: reading was paused, and maybe resumed before the cancel completed.
+        //
+        if (!connection->recv_armed_ && !connection->reading_paused_ && !connection->closing_ &&
+            !stop_requested_)
+            PrepareRecv(connection);
+    }
+    else if (res == 0 && !connection->held_.empty())
+    {
+        connection->peer_closed_ = true;
+    }
+    else
+    {
+        // Peer disconnected or connection is broken
+        CloseConnection(connection);
+    }
+}
+
+void UringReactor::HandleSend(UringConnection* connection, int res)
+{
+    if (res < 0)
+    {
+        {
+            std::lock_guard<std::mutex> lk(connection->messages_mtx_);
+            connection->sending_ = 0;
+        }
+
+        if (res != -ECANCELED) CloseConnection(connection);
+        return;
+    }
+
+    std::vector<SendCompletedCb> completed_cbs;
+    bool more = false;
+    bool writable_changed = false;
+
+    {
+        std::lock_guard<std::mutex> lk(connection->messages_mtx_);
+
+        auto& messages = connection->messages_;
+        size_t written = static_cast<size_t>(res);
+
+        connection->queued_bytes_ -= std::min(written, connection->queued_bytes_);
+        writable_changed = connection->watermarks_.Update(connection->queued_bytes_);
+
+        for (size_t i = 0; i < connection->sending_ && !messages.empty(); ++i)
+        {
+            auto& message = messages.front();
+            size_t len = std::min(written, message.view.size() - message.offset);
+
+            message.offset += len;
+            written -= len;
+
+            if (message.offset < message.view.size()) break;
+
+            if (message.completed_cb) completed_cbs.push_back(std::move(message.completed_cb));
+            messages.pop_front();
+        }
+
+        connection->sending_ = 0;
+        more = !messages.empty();
+        if (!more) connection->send_scheduled_ = false;
+    }
+
+    for (auto& completed_cb : completed_cbs) completed_cb(true);
+
+    if (writable_changed && connection->writable_cb_) connection->writable_cb_(true);
+    if (more && !stop_requested_) PrepareSend(connection);
+}
+
+void UringReactor::UpdateRecv(UringConnection* connection)
+{
+    if (connection->closing_ || stop_requested_) return;
+
+    if (connection->reading_paused_)
+    {
+        if (connection->recv_armed_) PrepareCancelRecv(connection);
+        return;
+    }
+
+    if (!DeliverHeld(connection)) return;
+
+    if (connection->peer_closed_)
+        CloseConnection(connection);
+    else if (!connection->recv_armed_)
+        PrepareRecv(connection);
+}
+
+bool UringReactor::DeliverHeld(UringConnection* connection)
+{
+    // The callback may pause reading again
+    while (!connection->held_.empty() && !connection->reading_paused_)
+    {
+        Buffer buffer = std::move(connection->held_.front());
+        connection->held_.pop_front();
+
+        if (!handler_->HandleReceive(*connection, buffer))
+        {
+            CloseConnection(connection);
+            return false;
+        }
+    }
+
+    return !connection->reading_paused_;
+}
+
+void UringReactor::CloseConnection(UringConnection* connection)
+{
+    if (connection->closing_) return;
+
+    connection->closing_ = true;
+    connection->open_ = false;
+    connection->held_.clear();
+
+    // Completes whatever is still in flight on the socket
+    shutdown(connection->socket_, SHUT_RDWR);
+
+    handler_->HandleClose(*connection);
+
+    // Nothing in flight, e.g. closed when resumed after the peer left: no completion would come
+    if (connection->ops_ == 0) ReleaseConnection(connection);
+}
+
+void UringReactor::ReleaseConnection(UringConnection* connection)
+{
+    connection->FailQueued();
+    if (connection->owns_socket_) close(connection->socket_);
+    connections_.erase(connection);
+}
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "libsercli/Buffer.h"
+#include "libsercli/BusyPollConfig.h"
+#include "libsercli/Callbacks.h"
+#include "libsercli/DataView.h"
+#include "libsercli/MemoryResource.h"
+#include "libsercli/PollStats.h"
+#include "libsercli/WatermarkConfig.h"
+
+#include "BufferPool.h"
+#include "Constants.h"
+#include "PollCounters.h"
+#include "IoUring.h"
+#include "ResourceAllocator.h"
+#include "SmartSocket.h"
+#include "ThreadPlacement.h"
+#include "Watermarks.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+class UringConnection;
+class UringReactor;
+
+// Linux 6.0 or newer and a ring can be set up
+bool IsIoUringSupported();
+
+//
+// Events of a UringReactor, always called from the reactor thread
+//
+class IUringHandler
+{
+public:
+    virtual ~IUringHandler() = default;
+
+    virtual void HandleAccept(SOCKET listener, SOCKET client) = 0;
+    // Accepting on the listener pauses for a moment, the process is out of resources
+    virtual void HandleAcceptPaused(SOCKET listener) = 0;
+    // Returns false to close the connection
+    virtual bool HandleReceive(UringConnection& connection, const Buffer& data) = 0;
+    // The peer is gone or the connection is broken, not called for connections closed by Stop()
+    virtual void HandleClose(UringConnection& connection) = 0;
+};
+
+//
+// Socket served by a UringReactor.
+// Send() copies the data to the connection's queue (SendBorrowed() only refers to it),
+// the reactor thread submits
+// the queues of all connections together in its next round.
+// The queue and the copies of the data come from resource, the global heap without one.
+//
+class UringConnection : public std::enable_shared_from_this<UringConnection>
+{
+public:
+    UringConnection(
+        SOCKET socket,
+        UringReactor* reactor,
+        bool owns_socket = true,
+        MemoryResource* resource = nullptr);
+    virtual ~UringConnection() = default;
+
+    UringConnection(const UringConnection&) = delete;
+    UringConnection& operator=(const UringConnection&) = delete;
+
+    SOCKET GetSocket() const;
+    bool IsOpen() const;
+
+    // Thread safe. Returns false if the connection is closed, completed_cb is not called then
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb);
+
+    // Same, but data must stay valid until completed_cb is called, it is never copied
+    bool SendBorrowed(const DataView* data, size_t count, SendCompletedCb completed_cb);
+
+    // Parts of sends not completed yet, including those in flight
+    size_t GetQueuedCount();
+
+    // To be called before the connection is added, writable_cb may be called from any thread
+    void SetWatermarks(
+        const WatermarkConfig& config,
+        std::function<void(bool writable)> writable_cb);
+    bool IsWritable();
+
+    //
+    // Thread safe. The multishot recv is cancelled, data it still brings in is held back
+    // until reading is resumed.
+    //
+    void PauseReading();
+    void ResumeReading();
+    bool IsReadingPaused() const;
+
+    //
+    // Reactor thread only, from HandleReceive() when reading was paused in the middle of data:
+    // the rest is held back ahead of whatever came in meanwhile, until reading is resumed
+    //
+    void HoldUnread(Buffer unread);
+
+private:
+    using Bytes = std::vector<uint8_t, ResourceAllocator<uint8_t>>;
+
+    struct Message
+    {
+        Bytes data;    // copy of the payload, empty for borrowed ones
+        DataView view; // the payload itself
+        size_t offset;
+        SendCompletedCb completed_cb;
+    };
+
+    using Messages = std::deque<Message, ResourceAllocator<Message>>;
+
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb, bool borrowed);
+
+    void FailQueued();
+
+    const SOCKET socket_;
+    UringReactor* const reactor_;
+    const bool owns_socket_;
+    const ResourceAllocator<uint8_t> allocator_;
+    std::atomic_bool open_;
+
+    Messages messages_;
+    std::mutex messages_mtx_;
+    bool send_scheduled_; // waiting in the reactor or a send is in flight
+    size_t queued_bytes_;
+    Watermarks watermarks_;
+    std::function<void(bool writable)> writable_cb_;
+    std::atomic_bool reading_paused_;
+
+    // Reactor thread only
+    size_t sending_; // messages in the send in flight
+    iovec send_iov_[kMaxIov];
+    msghdr send_msg_;
+    unsigned ops_; // requests in flight
+    bool closing_;
+    bool recv_armed_;
+    std::deque<Buffer, ResourceAllocator<Buffer>> held_; // received while reading is paused
+    bool peer_closed_; // closing is put off until held_ is delivered
+
+    friend class UringReactor;
+};
+
+using UringConnectionPtr = std::shared_ptr<UringConnection>;
+
+//
+// io_uring counterpart of Reactor: one ring served by one thread.
+// Listeners take a multishot accept, connections a multishot recv into buffers the kernel
+// picks from a registered buffer ring filled out of the BufferPool. Sends of all connections and
+// buffers given back are submitted with the same io_uring_enter() that waits for the next
+// completions.
+// Needs Linux 6.0 or newer.
+//
+class UringReactor
+{
+public:
+    UringReactor(
+        IUringHandler* handler,
+        BufferPool* pool,
+        size_t buffers,
+        const BusyPollConfig& busy_poll = BusyPollConfig());
+    ~UringReactor();
+
+    UringReactor(const UringReactor&) = delete;
+    UringReactor& operator=(const UringReactor&) = delete;
+
+    // Listeners must be added before Start()
+    void Listen(SOCKET listener);
+
+    //
+    // Returns once the ring is set up, false if io_uring is not available.
+    // placement: name and CPU of the reactor thread
+    //
+    bool Start(const ThreadPlacement& placement = ThreadPlacement());
+    // Closes all connections, HandleClose() is not called for them
+    void Stop();
+
+    // Thread safe
+    void Add(UringConnectionPtr connection);
+
+    //
+    // Thread safe. The multishot accepts are cancelled and taken again on resume, connections
+    // wait in the listen backlog meanwhile.
+    //
+    void SetAccepting(bool accepting);
+
+    // Adds this reactor's counters, thread safe
+    void AddPollStats(PollStats& stats) const;
+
+private:
+    enum Op : uint64_t
+    {
+        kAccept = 1,
+        kRecv,
+        kSend,
+        kWake,
+        kCancel,
+        kAcceptRetry,
+        kOpMask = 7
+    };
+
+    void Routine(std::promise<bool>* ready);
+    //
+    // Submits this round's requests and waits for a completion, polling for up to spin_time_
+    // first. Returns what the last io_uring_enter() did.
+    //
+    int SubmitAndWait();
+    bool Setup();
+    void Teardown();
+
+    // Called by UringConnection::Send(), thread safe
+    void ScheduleSend(UringConnectionPtr connection);
+    // Called by UringConnection::PauseReading() and ResumeReading(), thread safe
+    void ScheduleRecv(UringConnectionPtr connection);
+    void Schedule(std::vector<UringConnectionPtr>& list, UringConnectionPtr connection);
+    void Wake();
+
+    io_uring_sqe* NextSqe();
+    void PrepareAccept(size_t listener);
+    void PrepareAcceptRetry(size_t listener);
+    void PrepareRecv(UringConnection* connection);
+    void PrepareSend(UringConnection* connection);
+    void PrepareWake();
+    void PrepareCancelAll();
+    void PrepareCancelRecv(UringConnection* connection);
+    void PrepareCancelAccept(size_t listener);
+    // Puts buffers_[id] back into the buffer ring
+    void Provide(uint16_t id);
+
+    void HandleCompletion(uint64_t user_data, int res, uint32_t flags);
+    void HandleAccept(size_t listener, int res, uint32_t flags);
+    void UpdateAccepting();
+    void HandleRecv(UringConnection* connection, int res, uint32_t flags);
+    void HandleSend(UringConnection* connection, int res);
+    void UpdateRecv(UringConnection* connection);
+    // Returns false if the connection got closed meanwhile
+    bool DeliverHeld(UringConnection* connection);
+    void CloseConnection(UringConnection* connection);
+    // Once nothing is in flight any more
+    void ReleaseConnection(UringConnection* connection);
+
+    IUringHandler* const handler_;
+    BufferPool* const pool_;
+    const unsigned buffer_count_;
+    const PollCounters::Clock::duration spin_time_;
+    PollCounters poll_counters_;
+    std::vector<SOCKET> listeners_;
+
+    std::thread worker_thread_;
+    ThreadPlacement placement_;
+    std::atomic_bool stop_requested_;
+
+    // Handed over by other threads
+    std::vector<UringConnectionPtr> adds_;
+    std::vector<UringConnectionPtr> sends_;
+    std::vector<UringConnectionPtr> recvs_;
+    std::mutex scheduled_mtx_;
+    std::thread::id worker_id_;
+    bool wake_pending_;
+    std::atomic_bool accepting_;
+    bool accepting_changed_;
+    const int wake_fd_;
+
+    // Reactor thread only
+    IoUring ring_;
+    std::vector<Buffer> buffers_; // by buffer id, empty while the kernel fills it
+    std::vector<bool> accept_armed_; // by listener
+    std::unordered_map<UringConnection*, UringConnectionPtr> connections_;
+    std::vector<UringConnectionPtr> taken_adds_;
+    std::vector<UringConnectionPtr> taken_sends_;
+    std::vector<UringConnectionPtr> taken_recvs_;
+    uint64_t wake_value_;
+    const __kernel_timespec accept_retry_delay_;
+    size_t ops_; // requests in flight
+
+    friend class UringConnection;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
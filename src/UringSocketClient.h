@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <memory>
+
+#include "libsercli/ClientConfig.h"
+#include "libsercli/IClient.h"
+
+#include "BufferPool.h"
+#include "CallbackAdapters.h"
+#include "Constants.h"
+#include "Framing.h"
+#include "Macros.h"
+#include "ResourceAllocator.h"
+#include "SmartSocket.h"
+#include "ThreadPlacement.h"
+#include "UringReactor.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// io_uring counterpart of SocketClient
+//
+template <class SocketT>
+class UringSocketClient
+    : public IClient
+    , private IUringHandler
+{
+public:
+    template <class... Args>
+    UringSocketClient(const ClientConfig& config, const Args&... args)
+        : smart_socket_{args...}
+        , receive_pool_{BufferPool::Create(
+              config.socket_options.receive_chunk_size,
+              config.receive_pool,
+              GetBufferNode(config.io_thread, 0),
+              config.memory_resource)}
+        , reactor_{this, receive_pool_.get(), config.receive_pool.buffer_count, config.busy_poll}
+        , max_frame_size_{config.framing.enabled ? config.framing.max_frame_size : 0}
+        , memory_resource_{config.memory_resource}
+        , send_watermarks_{config.send_watermarks}
+        , placement_{GetThreadPlacement(config.io_thread, "sercli-cli", 0)}
+        , disconnected_{true}
+        , reading_paused_{false}
+    {
+        smart_socket_.ApplyOptions(config.socket_options);
+    }
+
+    ~UringSocketClient()
+    {
+        Disconnect();
+    }
+
+    bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientDataReceivedCb data_received_cb) override
+    {
+        return Connect(server_disconnected_cb, ToBufferReceivedCb(data_received_cb));
+    }
+
+    bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientDataViewReceivedCb data_received_cb)
+        override
+    {
+        return Connect(server_disconnected_cb, ToBufferReceivedCb(data_received_cb));
+    }
+
+    bool Connect(ServerDisconnectedCb server_disconnected_cb, ClientBufferReceivedCb data_received_cb)
+        override
+    {
+        smart_socket_.Start();
+
+        if (smart_socket_.GetRawSocket() == kSocketError) return false;
+
+        server_disconnected_cb_ = server_disconnected_cb;
+        data_received_cb_ = data_received_cb;
+
+        if (max_frame_size_ > 0)
+        {
+            frame_decoder_ = MakeResourceUnique<FrameDecoder>(
+                memory_resource_, receive_pool_.get(), max_frame_size_);
+        }
+
+        if (!reactor_.Start(placement_)) return false;
+
+        // The socket stays with smart_socket_
+        connection_ = std::allocate_shared<UringConnection>(
+            ResourceAllocator<UringConnection>(memory_resource_),
+            smart_socket_.GetRawSocket(),
+            &reactor_,
+            false,
+            memory_resource_);
+        connection_->SetWatermarks(send_watermarks_, [this](bool writable) {
+            if (writable_cb_) writable_cb_(writable);
+        });
+
+        // Paused before connecting
+        if (reading_paused_) connection_->PauseReading();
+
+        disconnected_ = false;
+        reactor_.Add(connection_);
+
+        return true;
+    }
+
+    void Disconnect() override
+    {
+        disconnected_ = true;
+        reactor_.Stop();
+    }
+
+    void SetWritableCb(WritableCb writable_cb) override
+    {
+        writable_cb_ = writable_cb;
+    }
+
+    using IClient::Send;
+    using IClient::SendZeroCopy;
+
+    bool Send(const std::vector<uint8_t>& data) override
+    {
+        return Send(data, nullptr);
+    }
+
+    bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) override
+    {
+        DataView view(data);
+
+        return Send(&view, 1, std::move(completed_cb));
+    }
+
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        if (disconnected_) return false;
+
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
+        return connection_->Send(frame.data(), frame.count(), std::move(completed_cb));
+    }
+
+    bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        return Send(data, count, std::move(completed_cb));
+    }
+
+    bool Flush() override
+    {
+        return !disconnected_; // queued sends are submitted every round anyway
+    }
+
+    void PauseReading() override
+    {
+        reading_paused_ = true;
+        if (!disconnected_) connection_->PauseReading();
+    }
+
+    void ResumeReading() override
+    {
+        reading_paused_ = false;
+        if (!disconnected_) connection_->ResumeReading();
+    }
+
+    bool IsWritable() override
+    {
+        return disconnected_ || connection_->IsWritable();
+    }
+
+    PollStats GetPollStats() override
+    {
+        PollStats stats;
+        reactor_.AddPollStats(stats);
+        return stats;
+    }
+
+private:
+    void HandleAccept(SOCKET listener, SOCKET client_socket) override
+    {
+        UNUSED(listener);
+        UNUSED(client_socket);
+    }
+
+    void HandleAcceptPaused(SOCKET listener) override
+    {
+        UNUSED(listener);
+    }
+
+    bool HandleReceive(UringConnection& connection, const Buffer& data) override
+    {
+        if (!data_received_cb_) return true;
+
+        if (!frame_decoder_)
+        {
+            data_received_cb_(data);
+            return true;
+        }
+
+        Buffer unread;
+
+        // A frame over the limit closes the connection
+        bool ok = frame_decoder_->Feed(
+            data,
+            [&](const Buffer& frame) {
+                data_received_cb_(frame);
+                return !connection.IsReadingPaused();
+            },
+            &unread);
+
+        // Paused from the callback, the rest waits for ResumeReading()
+        if (unread) connection.HoldUnread(std::move(unread));
+
+        return ok;
+    }
+
+    void HandleClose(UringConnection& connection) override
+    {
+        UNUSED(connection);
+
+        // Server disconnected
+        disconnected_ = true;
+        if (server_disconnected_cb_) server_disconnected_cb_();
+    }
+
+    SmartSocket<Client, SocketT> smart_socket_;
+    BufferPoolPtr receive_pool_;
+    UringReactor reactor_;
+    const size_t max_frame_size_; // 0 with framing off
+    MemoryResource* const memory_resource_; // nullptr for the global heap
+    const WatermarkConfig send_watermarks_;
+    const ThreadPlacement placement_;
+    ResourceUniquePtr<FrameDecoder> frame_decoder_;
+    UringConnectionPtr connection_;
+    std::atomic_bool disconnected_;
+    std::atomic_bool reading_paused_;
+    ServerDisconnectedCb server_disconnected_cb_;
+    WritableCb writable_cb_;
+    ClientBufferReceivedCb data_received_cb_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
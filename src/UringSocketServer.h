@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libsercli/IServer.h"
+#include "libsercli/ServerConfig.h"
+
+#include "BufferPool.h"
+#include "CallbackAdapters.h"
+#include "CallbackExecutor.h"
+#include "ClientTable.h"
+#include "ConnectionLimit.h"
+#include "Constants.h"
+#include "Framing.h"
+#include "Macros.h"
+#include "ResourceAllocator.h"
+#include "SmartSocket.h"
+#include "ThreadPlacement.h"
+#include "UringReactor.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+class UringClientHandler
+    : public IClientHandler
+    , public UringConnection
+{
+public:
+    UringClientHandler(
+        SOCKET client_socket,
+        ClientId client_id,
+        UringReactor* reactor,
+        BufferPool* receive_pool,
+        size_t max_frame_size,
+        MemoryResource* resource)
+        : UringConnection{client_socket, reactor, true, resource}
+        , client_id_{client_id}
+        , id_{std::to_string(client_id)}
+        , max_frame_size_{max_frame_size}
+    {
+        if (max_frame_size_ > 0)
+        {
+            frame_decoder_ =
+                MakeResourceUnique<FrameDecoder>(resource, receive_pool, max_frame_size_);
+        }
+    }
+
+    const std::string& GetId() override
+    {
+        return id_;
+    }
+
+    ClientId GetClientId() override
+    {
+        return client_id_;
+    }
+
+    bool IsConnected() override
+    {
+        return IsOpen();
+    }
+
+    using IClientHandler::Send;
+    using IClientHandler::SendZeroCopy;
+
+    bool Send(const std::vector<uint8_t>& data) override
+    {
+        return Send(data, nullptr);
+    }
+
+    bool Send(const std::vector<uint8_t>& data, SendCompletedCb completed_cb) override
+    {
+        DataView view(data);
+
+        return Send(&view, 1, std::move(completed_cb));
+    }
+
+    bool Send(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        OutgoingFrame frame(data, count, max_frame_size_);
+        if (!frame) return false;
+
+        return UringConnection::Send(frame.data(), frame.count(), std::move(completed_cb));
+    }
+
+    bool SendZeroCopy(const DataView* data, size_t count, SendCompletedCb completed_cb) override
+    {
+        return Send(data, count, std::move(completed_cb));
+    }
+
+    bool Flush() override
+    {
+        return IsOpen(); // queued sends are submitted every round anyway
+    }
+
+    void PauseReading() override
+    {
+        UringConnection::PauseReading();
+    }
+
+    void ResumeReading() override
+    {
+        UringConnection::ResumeReading();
+    }
+
+    bool IsWritable() override
+    {
+        return UringConnection::IsWritable();
+    }
+
+private:
+    //
+    // Broadcast payload, already framed: the queue refers to it until it is written
+    //
+    void SendShared(const SharedPayload& payload, BroadcastResult& result)
+    {
+        DataView view(*payload);
+
+        if (SendBorrowed(&view, 1, [payload](bool) {}))
+        {
+            ++result.sent;
+            if (GetQueuedCount() > 1) ++result.backpressured;
+        }
+        else
+        {
+            ++result.skipped;
+        }
+    }
+
+    const ClientId client_id_;
+    const std::string id_;
+    const size_t max_frame_size_; // 0 with framing off
+    ResourceUniquePtr<FrameDecoder> frame_decoder_;
+    CallbackStrandPtr strand_; // with a callback executor only
+
+    template <class SocketT>
+    friend class UringSocketServer;
+};
+
+using UringClientHandlerPtr = std::shared_ptr<UringClientHandler>;
+
+//
+// io_uring counterpart of SocketServer
+//
+template <class SocketT>
+class UringSocketServer
+    : public IServer
+    , private IUringHandler
+{
+public:
+    template <class... Args>
+    UringSocketServer(const ServerConfig& config, const Args&... args)
+        : memory_resource_{config.memory_resource}
+        , receive_pool_{BufferPool::Create(
+              config.socket_options.receive_chunk_size,
+              config.receive_pool,
+              -1,
+              memory_resource_)}
+        , max_frame_size_{config.framing.enabled ? config.framing.max_frame_size : 0}
+        , send_watermarks_{config.send_watermarks}
+        , admission_{config.admission}
+        , io_threads_{config.io_threads}
+        , executor_{
+              config.callback_executor.threads > 0
+                  ? std::make_unique<CallbackExecutor>(config.callback_executor.threads)
+                  : nullptr}
+        , stopped_{true}
+        , connection_limit_{config.admission.max_connections, [this](bool accepting) {
+            for (auto& reactor : reactors_) reactor->SetAccepting(accepting);
+        }}
+    {
+        // The only one accepted sockets may not inherit from the listener
+        accepted_options_.tcp_quickack = config.socket_options.tcp_quickack;
+
+        size_t reactors = std::max<size_t>(config.reactor_threads, 1);
+        size_t listeners = SocketT::kReusePort ? reactors : 1;
+        size_t buffers = std::max<size_t>(config.receive_pool.buffer_count / reactors, 1);
+
+        IUringHandler* handler = this;
+
+        for (size_t i = 0; i < reactors; ++i)
+        {
+            BufferPool* pool = receive_pool_.get();
+            int numa_node = GetBufferNode(io_threads_, i);
+
+            if (numa_node >= 0)
+            {
+                BufferPoolConfig pool_config = config.receive_pool;
+                pool_config.buffer_count = buffers;
+
+                numa_pools_.emplace_back(BufferPool::Create(
+                    config.socket_options.receive_chunk_size,
+                    pool_config,
+                    numa_node,
+                    memory_resource_));
+                pool = numa_pools_.back().get();
+            }
+
+            reactor_pools_.push_back(pool);
+            reactors_.emplace_back(
+                std::make_unique<UringReactor>(handler, pool, buffers, config.busy_poll));
+        }
+
+        for (size_t i = 0; i < listeners; ++i)
+        {
+            auto listener = std::make_unique<SmartSocket<Server, SocketT>>(args...);
+
+            if (listeners > 1) listener->SetOption(SOL_SOCKET, SO_REUSEPORT, 1);
+            listener->ApplyOptions(config.socket_options);
+
+            reactors_[i]->Listen(listener->GetRawSocket());
+            listeners_.emplace_back(std::move(listener));
+        }
+    }
+
+    ~UringSocketServer() { Stop(); }
+
+    bool Start(ClientStatusCb client_status_cb, ServerDataReceivedCb server_data_received_cb) override
+    {
+        return Start(client_status_cb, ToBufferReceivedCb(server_data_received_cb));
+    }
+
+    bool Start(ClientStatusCb client_status_cb, ServerDataViewReceivedCb server_data_received_cb)
+        override
+    {
+        return Start(client_status_cb, ToBufferReceivedCb(server_data_received_cb));
+    }
+
+    bool Start(ClientStatusCb client_status_cb, ServerBufferReceivedCb server_data_received_cb)
+        override
+    {
+        return Start(client_status_cb, server_data_received_cb, nullptr);
+    }
+
+    bool Start(IServerHandler& handler) override { return Start(nullptr, nullptr, &handler); }
+
+    // Either the callbacks or the handler
+    bool Start(
+        ClientStatusCb client_status_cb,
+        ServerBufferReceivedCb server_data_received_cb,
+        IServerHandler* server_handler)
+    {
+        if (!stopped_) return false;
+
+        client_status_cb_ = client_status_cb;
+        server_data_received_cb_ = server_data_received_cb;
+        server_handler_ = server_handler;
+
+        for (auto& listener : listeners_)
+        {
+            listener->Start(admission_.backlog);
+
+            if (listener->GetRawSocket() == kSocketError) return false;
+        }
+
+        stopped_ = false;
+
+        if (executor_) executor_->Start();
+
+        for (size_t i = 0; i < reactors_.size(); ++i)
+        {
+            if (!reactors_[i]->Start(GetThreadPlacement(io_threads_, "sercli-srv", i)))
+            {
+                Stop();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Stop() override
+    {
+        stopped_ = true;
+
+        for (auto& reactor : reactors_) reactor->Stop();
+
+        // Callbacks still queued run before it returns
+        if (executor_) executor_->Stop();
+
+        clients_.Clear([](const UringClientHandlerPtr&) {});
+
+        // Accepts again once restarted
+        connection_limit_.Update(clients_);
+    }
+
+    void SetClientWritableCb(ClientWritableCb client_writable_cb) override
+    {
+        client_writable_cb_ = client_writable_cb;
+    }
+
+    void SetConnectionRejectedCb(ConnectionRejectedCb connection_rejected_cb) override
+    {
+        connection_rejected_cb_ = connection_rejected_cb;
+    }
+
+    std::vector<IClientHandlerPtr> GetClients() override
+    {
+        std::vector<IClientHandlerPtr> clients;
+
+        GetClients(clients);
+
+        return clients;
+    }
+
+    void GetClients(std::vector<IClientHandlerPtr>& clients) override
+    {
+        clients.clear();
+
+        clients_.ForEach([&](const UringClientHandlerPtr& client) { clients.emplace_back(client); });
+    }
+
+    using IServer::GetClient;
+
+    IClientHandlerPtr GetClient(ClientId id) override
+    {
+        return clients_.Find(id);
+    }
+
+    PollStats GetPollStats() override
+    {
+        PollStats stats;
+
+        for (auto& reactor : reactors_) reactor->AddPollStats(stats);
+
+        return stats;
+    }
+
+    ExecutorStats GetExecutorStats() override
+    {
+        return executor_ ? executor_->GetStats() : ExecutorStats();
+    }
+
+    BroadcastResult Broadcast(DataView data, ClientFilter filter) override
+    {
+        BroadcastResult result;
+
+        auto payload = MakeSharedFrame(data, max_frame_size_);
+        if (!payload) return result;
+
+        clients_.ForEach([&](const UringClientHandlerPtr& client) {
+            if (!filter || filter(*client)) client->SendShared(payload, result);
+        });
+
+        return result;
+    }
+
+    BroadcastResult Broadcast(DataView data, const std::vector<ClientId>& ids) override
+    {
+        BroadcastResult result;
+
+        auto payload = MakeSharedFrame(data, max_frame_size_);
+        if (!payload) return result;
+
+        for (ClientId id : ids)
+        {
+            auto client = clients_.Find(id);
+
+            if (client)
+                client->SendShared(payload, result);
+            else
+                ++result.skipped;
+        }
+
+        return result;
+    }
+
+private:
+    void HandleAccept(SOCKET listener, SOCKET client_socket) override
+    {
+        //
+        // SO_REUSEPORT listeners feed their own reactor,
+        // the only UNIX socket listener hands clients off round-robin
+        //
+        size_t reactor = 0;
+
+        if (listeners_.size() == reactors_.size())
+        {
+            while (listeners_[reactor]->GetRawSocket() != listener) ++reactor;
+        }
+        else
+        {
+            reactor = next_reactor_++ % reactors_.size();
+        }
+
+        ApplySocketOptions(client_socket, accepted_options_, SocketT::kTcp);
+
+        auto make = [&](ClientId id) {
+            auto handler = std::allocate_shared<UringClientHandler>(
+                ResourceAllocator<UringClientHandler>(memory_resource_),
+                client_socket,
+                id,
+                reactors_[reactor].get(),
+                reactor_pools_[reactor],
+                max_frame_size_,
+                memory_resource_);
+
+            if (executor_)
+            {
+                handler->strand_ = std::allocate_shared<CallbackStrand>(
+                    ResourceAllocator<CallbackStrand>(memory_resource_));
+            }
+
+            UringClientHandler* raw = handler.get();
+            handler->SetWatermarks(
+                send_watermarks_, [this, raw](bool writable) { NotifyWritable(raw, writable); });
+
+            return handler;
+        };
+
+        auto client = clients_.Add(client_socket, make, admission_.max_connections);
+
+        if (!client)
+        {
+            close(client_socket);
+
+            //
+            // Accepted just before the limit cancelled the accepts,
+            // otherwise the socket was out of the client table's range
+            //
+            if (connection_rejected_cb_ && admission_.max_connections > 0 &&
+                clients_.GetCount() >= admission_.max_connections)
+                connection_rejected_cb_(RejectReason::kConnectionLimit);
+            return;
+        }
+
+        if (connection_limit_.Update(clients_) && connection_rejected_cb_)
+            connection_rejected_cb_(RejectReason::kConnectionLimit);
+
+        NotifyStatus(client, true);
+
+        reactors_[reactor]->Add(client);
+    }
+
+    void HandleAcceptPaused(SOCKET listener) override
+    {
+        UNUSED(listener);
+
+        if (connection_rejected_cb_) connection_rejected_cb_(RejectReason::kOutOfResources);
+    }
+
+    bool HandleReceive(UringConnection& connection, const Buffer& data) override
+    {
+        if (!server_handler_ && !server_data_received_cb_) return true;
+
+        auto& handler = static_cast<UringClientHandler&>(connection);
+
+        // Borrowed by the handler interface
+        UringClientHandlerPtr client;
+        if (!server_handler_ || executor_)
+            client = std::static_pointer_cast<UringClientHandler>(connection.shared_from_this());
+
+        if (!handler.frame_decoder_)
+        {
+            Dispatch(handler, client, data);
+            return true;
+        }
+
+        Buffer unread;
+
+        // A frame over the limit closes the connection
+        bool ok = handler.frame_decoder_->Feed(
+            data,
+            [&](const Buffer& frame) {
+                Dispatch(handler, client, frame);
+                return !connection.IsReadingPaused();
+            },
+            &unread);
+
+        // Paused from the callback, the rest waits for ResumeReading()
+        if (unread) connection.HoldUnread(std::move(unread));
+
+        return ok;
+    }
+
+    void HandleClose(UringConnection& connection) override
+    {
+        auto client = std::static_pointer_cast<UringClientHandler>(connection.shared_from_this());
+
+        clients_.Remove(connection.GetSocket());
+        connection_limit_.Update(clients_);
+
+        if (!server_handler_ && !client_status_cb_) return;
+
+        // After the data callbacks still queued for the client
+        if (executor_)
+            executor_->Post(client->strand_, [this, client]() { NotifyStatus(client, false); });
+        else
+            NotifyStatus(client, false);
+    }
+
+    //
+    // Data callback, on the executor if there is one. The task keeps the buffer,
+    // the reactor provides a fresh one to the kernel meanwhile.
+    //
+    // client is null when the handler interface takes the data inline
+    void Dispatch(
+        UringClientHandler& handler,
+        const UringClientHandlerPtr& client,
+        const Buffer& data)
+    {
+        if (!executor_)
+        {
+            NotifyReceived(handler, client, data);
+            return;
+        }
+
+        executor_->Post(
+            client->strand_, [this, client, data]() { NotifyReceived(*client, client, data); });
+    }
+
+    void NotifyReceived(
+        UringClientHandler& handler,
+        const UringClientHandlerPtr& client,
+        const Buffer& data)
+    {
+        if (server_handler_)
+            server_handler_->OnDataReceived(handler, data);
+        else
+            server_data_received_cb_(client, data);
+    }
+
+    void NotifyStatus(const UringClientHandlerPtr& client, bool connected)
+    {
+        if (server_handler_)
+            server_handler_->OnClientStatus(*client, connected);
+        else if (client_status_cb_)
+            client_status_cb_(client, connected);
+    }
+
+    void NotifyWritable(UringClientHandler* handler, bool writable)
+    {
+        if (!client_writable_cb_) return;
+
+        client_writable_cb_(
+            std::static_pointer_cast<UringClientHandler>(handler->shared_from_this()), writable);
+    }
+
+    MemoryResource* const memory_resource_; // nullptr for the global heap
+    BufferPoolPtr receive_pool_;
+    std::vector<BufferPoolPtr> numa_pools_; // NUMA local shares of the pool, if split
+    std::vector<BufferPool*> reactor_pools_; // by reactor
+    const size_t max_frame_size_; // 0 with framing off
+    const WatermarkConfig send_watermarks_;
+    const AdmissionConfig admission_;
+    const ThreadConfig io_threads_;
+    std::unique_ptr<CallbackExecutor> executor_; // data callbacks run inline without one
+    SocketOptions accepted_options_;
+    std::vector<std::unique_ptr<UringReactor>> reactors_;
+    std::vector<std::unique_ptr<SmartSocket<Server, SocketT>>> listeners_;
+    ClientTable<UringClientHandler> clients_;
+    std::atomic_bool stopped_;
+    std::atomic_size_t next_reactor_{0};
+    ConnectionLimit connection_limit_; // AdmissionConfig::max_connections
+    ClientStatusCb client_status_cb_;
+    ClientWritableCb client_writable_cb_;
+    ConnectionRejectedCb connection_rejected_cb_;
+    ServerBufferReceivedCb server_data_received_cb_;
+    IServerHandler* server_handler_ = nullptr; // instead of the two callbacks
+};
+
+} // namespace libsercli
+} // namespace nkhlab
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "libsercli/WatermarkConfig.h"
+
+namespace nkhlab {
+namespace libsercli {
+
+//
+// Writability of one connection, followed from the bytes it has queued. Not thread safe.
+//
+class Watermarks
+{
+public:
+    explicit Watermarks(const WatermarkConfig& config = WatermarkConfig())
+        : high_{config.high}
+        , low_{std::min(config.low, config.high)}
+        , writable_{true}
+    {
+    }
+
+    // Returns true when writability changed
+    bool Update(size_t queued_bytes)
+    {
+        if (writable_ && high_ > 0 && queued_bytes >= high_)
+            writable_ = false;
+        else if (!writable_ && queued_bytes <= low_)
+            writable_ = true;
+        else
+            return false;
+
+        return true;
+    }
+
+    bool IsWritable() const { return writable_; }
+
+    void Reset() { writable_ = true; }
+
+private:
+    size_t high_;
+    size_t low_;
+    bool writable_;
+};
+
+} // namespace libsercli
+} // namespace nkhlab
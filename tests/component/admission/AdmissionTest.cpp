@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// A server limited to kMaxConnections clients: once they are connected it reports the limit and
+// stops accepting, a client over it waits in the listen backlog, neither served nor closed.
+// When a client leaves, the waiting one is taken on and gets the echo of what it sent meanwhile.
+//
+constexpr char kIoUringOption[] = "--io-uring";
+constexpr size_t kMaxConnections = 2;
+constexpr auto kTimeout = 2s;
+constexpr auto kQuietTime = 200ms;
+
+// Counts of what happened, waited for by the test
+class Events
+{
+public:
+    void Add(const std::string& event)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            events_.push_back(event);
+        }
+        cv_.notify_all();
+    }
+
+    size_t Count(const std::string& event)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return CountLocked(event);
+    }
+
+    bool WaitFor(const std::string& event, size_t count)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return cv_.wait_for(lk, kTimeout, [&]() { return CountLocked(event) >= count; });
+    }
+
+    // Nothing more of it comes in for a while
+    bool StaysAt(const std::string& event, size_t count)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return !cv_.wait_for(lk, kQuietTime, [&]() { return CountLocked(event) > count; }) &&
+               CountLocked(event) == count;
+    }
+
+private:
+    size_t CountLocked(const std::string& event) const
+    {
+        size_t count = 0;
+        for (auto& e : events_) count += e == event;
+        return count;
+    }
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<std::string> events_;
+};
+
+class Endpoint
+{
+public:
+    Endpoint(int argc, char const* argv[])
+        : argc_{argc}
+        , argv_{argv}
+    {
+    }
+
+    IServerPtr CreateServer(const ServerConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixServer(argv_[1], config)
+                          : CreateInetServer(argv_[1], atoi(argv_[2]), config);
+    }
+
+    IClientPtr CreateClient(const ClientConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixClient(argv_[1], config)
+                          : CreateInetClient(argv_[1], atoi(argv_[2]), config);
+    }
+
+private:
+    const int argc_;
+    char const** const argv_;
+};
+
+std::vector<uint8_t> ToBytes(const std::string& str)
+{
+    return std::vector<uint8_t>(str.begin(), str.end());
+}
+
+// Connects a client that records its echoes and its disconnection under its name
+IClientPtr Connect(
+    const Endpoint& endpoint,
+    const ClientConfig& config,
+    Events& events,
+    const std::string& name)
+{
+    auto client = endpoint.CreateClient(config);
+    if (!client) return nullptr;
+
+    bool connected = client->Connect(
+        [&events, name]() { events.Add(name + " disconnected"); },
+        [&events, name](DataView data) {
+            events.Add(name + " got " + std::string(data.begin(), data.end()));
+        });
+
+    if (!connected) return nullptr;
+
+    return client;
+}
+
+bool TestAdmission(const Endpoint& endpoint, const ClientConfig& config, Events& server)
+{
+    // Destroyed after the clients
+    Events events;
+    std::vector<IClientPtr> clients;
+
+    for (size_t i = 0; i < kMaxConnections; ++i)
+    {
+        std::string name = "client" + std::to_string(i);
+
+        clients.push_back(Connect(endpoint, config, events, name));
+        if (!clients.back() || !clients.back()->Send(ToBytes("x")) || !events.WaitFor(name + " got x", 1))
+            return false;
+    }
+
+    if (!server.WaitFor("limit", 1)) return false;
+
+    // Connected from the client's side, but not accepted
+    auto waiting = Connect(endpoint, config, events, "waiting");
+
+    if (!waiting || !waiting->Send(ToBytes("w")) || !events.StaysAt("waiting got w", 0) ||
+        events.Count("waiting disconnected") != 0 || server.Count("connected") != kMaxConnections)
+        return false;
+
+    // Its place is taken by the waiting one, the server is full again
+    clients[0].reset();
+
+    return events.WaitFor("waiting got w", 1) && server.WaitFor("limit", 2) &&
+           server.Count("connected") == kMaxConnections + 1 &&
+           events.Count("waiting disconnected") == 0;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from AdmissionTest!\n";
+
+    Backend backend = Backend::kEpoll;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    Endpoint endpoint(argc, argv);
+
+    ServerConfig server_config;
+    server_config.backend = backend;
+    server_config.admission.max_connections = kMaxConnections;
+
+    ClientConfig client_config;
+    client_config.backend = backend;
+
+    auto server = endpoint.CreateServer(server_config);
+
+    if (!server)
+    {
+        std::cout << "ERROR: server is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    Events server_events;
+
+    server->SetConnectionRejectedCb([&](RejectReason reason) {
+        server_events.Add(reason == RejectReason::kConnectionLimit ? "limit" : "resources");
+    });
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr, bool connected) {
+            server_events.Add(connected ? "connected" : "disconnected");
+        },
+        [](IClientHandlerPtr client, DataView data) { client->Send({data}); });
+
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    bool ok = TestAdmission(endpoint, client_config, server_events);
+
+    server->Stop();
+
+    if (!ok)
+    {
+        std::cout << "ERROR: connection over the limit was not held back until a client left!\n";
+        return EXIT_FAILURE;
+    }
+
+    if (server_events.Count("resources") != 0)
+    {
+        std::cout << "ERROR: server ran out of resources!\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Successfull admission!\n";
+
+    return EXIT_SUCCESS;
+}
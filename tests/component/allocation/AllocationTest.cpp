@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Ping-pong echo between the server and the client once the connection is set up and warmed up:
+// the server's and the client's read paths and Send() must not allocate. Every malloc() of the
+// process is counted while the echo runs, whichever thread makes it.
+//
+constexpr size_t kWarmUpRoundTrips = 1000;
+constexpr size_t kRoundTrips = 10000;
+constexpr size_t kPingSize = 64;
+constexpr auto kEchoTimeout = 2s;
+
+namespace {
+
+std::atomic_bool counting{false};
+std::atomic_size_t allocations{0};
+
+void CountAllocation()
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+//
+// operator new of the C++ runtime comes through malloc() too
+//
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size) noexcept
+{
+    CountAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept
+{
+    CountAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) noexcept
+{
+    CountAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+class Echo
+{
+public:
+    void OnData(DataView data)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            received_ += data.size();
+        }
+        cv_.notify_all();
+    }
+
+    bool WaitFor(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        return cv_.wait_for(lk, kEchoTimeout, [&]() { return received_ >= bytes; });
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    size_t received_ = 0;
+};
+
+bool Run(int argc, char const* argv[], bool framing, const std::string& title)
+{
+    ServerConfig server_config;
+    server_config.framing.enabled = framing;
+
+    ClientConfig client_config;
+    client_config.framing.enabled = framing;
+
+    IServerPtr server;
+    IClientPtr client;
+
+    if (argc == 2)
+    {
+        server = CreateUnixServer(argv[1], server_config);
+        client = CreateUnixClient(argv[1], client_config);
+    }
+    else
+    {
+        server = CreateInetServer(argv[1], atoi(argv[2]), server_config);
+        client = CreateInetClient(argv[1], atoi(argv[2]), client_config);
+    }
+
+    if (!server || !client)
+    {
+        std::cout << "ERROR: server or client is nullptr!\n";
+        return false;
+    }
+
+    bool started = server->Start(
+        [](IClientHandlerPtr, bool) {},
+        [](IClientHandlerPtr client, DataView data) { client->Send({data}); });
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return false;
+    }
+
+    Echo echo;
+
+    if (!client->Connect([]() {}, [&](DataView data) { echo.OnData(data); }))
+    {
+        std::cout << "ERROR: client failed to connect!\n";
+        return false;
+    }
+
+    uint8_t ping[kPingSize] = {};
+    size_t expected = 0;
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < kWarmUpRoundTrips + kRoundTrips; ++i)
+    {
+        if (i == kWarmUpRoundTrips) counting = true;
+
+        expected += kPingSize;
+        ok = client->Send({DataView(ping, kPingSize)}) && echo.WaitFor(expected);
+    }
+
+    counting = false;
+
+    client.reset();
+    server->Stop();
+
+    if (!ok)
+    {
+        std::cout << "ERROR: " << title << ": echo timed out!\n";
+        return false;
+    }
+
+    std::cout << title << ": " << allocations << " allocations in " << kRoundTrips
+              << " round trips\n";
+
+    bool allocation_free = allocations == 0;
+    allocations = 0;
+
+    return allocation_free;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from AllocationTest!\n";
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: <unix socket path>\n";
+        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    bool stream = Run(argc, argv, false, "Stream ");
+    bool framed = Run(argc, argv, true, "Framing");
+
+    if (!stream || !framed)
+    {
+        std::cout << "ERROR: the steady state allocates!\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Allocation free steady state!\n";
+
+    return EXIT_SUCCESS;
+}
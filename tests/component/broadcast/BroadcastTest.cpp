@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Broadcasts to all clients, to a list of IDs and through a filter, with framing off and on.
+// Every client must get each payload meant for it exactly once and in order, and nothing else.
+//
+constexpr size_t kClients = 6;
+constexpr size_t kBroadcasts = 10;
+constexpr size_t kPayloadSize = 1000;
+constexpr auto kTimeout = 2s;
+constexpr auto kQuietTime = 100ms;
+constexpr char kIoUringOption[] = "--io-uring";
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes Payload(uint8_t seed)
+{
+    Bytes payload(kPayloadSize);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<uint8_t>(seed * 7 + i);
+    return payload;
+}
+
+class Receiver
+{
+public:
+    void OnData(DataView data)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+
+        messages_.emplace_back(data.begin(), data.end());
+        received_ += data.size();
+        cv_.notify_all();
+    }
+
+    // framed: one message per payload, otherwise only the bytes count
+    bool Expect(const std::vector<Bytes>& payloads, bool framed)
+    {
+        size_t bytes = 0;
+        Bytes stream;
+
+        for (auto& payload : payloads)
+        {
+            bytes += payload.size();
+            stream.insert(stream.end(), payload.begin(), payload.end());
+        }
+
+        std::unique_lock<std::mutex> lk(m_);
+
+        cv_.wait_for(lk, kTimeout, [&]() { return received_ >= bytes; });
+        cv_.wait_for(lk, kQuietTime, [&]() { return received_ > bytes; });
+
+        if (framed) return messages_ == payloads;
+
+        Bytes received;
+        for (auto& message : messages_) received.insert(received.end(), message.begin(), message.end());
+
+        return received == stream;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<Bytes> messages_;
+    size_t received_ = 0;
+};
+
+// Server side IDs of the clients, by the index each of them sends first
+class Registry
+{
+public:
+    void OnData(IClientHandler& client, DataView data)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+
+        for (uint8_t index : data) ids_[index] = client.GetClientId();
+        cv_.notify_all();
+    }
+
+    bool WaitFor(size_t clients, std::map<size_t, ClientId>& ids)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        if (!cv_.wait_for(lk, kTimeout, [&]() { return ids_.size() >= clients; })) return false;
+
+        ids = ids_;
+        return true;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::map<size_t, ClientId> ids_;
+};
+
+bool Run(int argc, char const* argv[], Backend backend, bool framing, const std::string& title)
+{
+    ServerConfig server_config;
+    server_config.backend = backend;
+    server_config.framing.enabled = framing;
+
+    ClientConfig client_config;
+    client_config.backend = backend;
+    client_config.framing.enabled = framing;
+
+    IServerPtr server = argc == 2 ? CreateUnixServer(argv[1], server_config)
+                                  : CreateInetServer(argv[1], atoi(argv[2]), server_config);
+
+    Registry registry;
+
+    if (!server || !server->Start(
+                       [](IClientHandlerPtr, bool) {},
+                       [&](IClientHandlerPtr client, DataView data) {
+                           registry.OnData(*client, data);
+                       }))
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return false;
+    }
+
+    // Destroyed after the clients
+    std::vector<Receiver> receivers(kClients);
+    std::vector<IClientPtr> clients;
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        clients.push_back(
+            argc == 2 ? CreateUnixClient(argv[1], client_config)
+                      : CreateInetClient(argv[1], atoi(argv[2]), client_config));
+
+        Receiver& receiver = receivers[i];
+
+        if (!clients[i] ||
+            !clients[i]->Connect([]() {}, [&](DataView data) { receiver.OnData(data); }) ||
+            !clients[i]->Send(Bytes{static_cast<uint8_t>(i)}))
+        {
+            std::cout << "ERROR: client failed to connect!\n";
+            return false;
+        }
+    }
+
+    std::map<size_t, ClientId> ids;
+
+    if (!registry.WaitFor(kClients, ids))
+    {
+        std::cout << "ERROR: " << title << ": clients are not known to the server!\n";
+        return false;
+    }
+
+    bool ok = true;
+    std::vector<Bytes> expected[kClients];
+
+    for (size_t i = 0; i < kBroadcasts; ++i)
+    {
+        Bytes payload = Payload(static_cast<uint8_t>(i));
+        BroadcastResult result = server->Broadcast(DataView(payload));
+
+        if (result.sent != kClients || result.skipped != 0) ok = false;
+        for (auto& client_expected : expected) client_expected.push_back(payload);
+    }
+
+    // Even clients by ID, odd ones through a filter
+    std::vector<ClientId> even_ids;
+    for (size_t i = 0; i < kClients; i += 2) even_ids.push_back(ids[i]);
+
+    Bytes to_even = Payload(100);
+    BroadcastResult even_result = server->Broadcast(DataView(to_even), even_ids);
+
+    Bytes to_odd = Payload(200);
+    BroadcastResult odd_result = server->Broadcast(DataView(to_odd), [&](IClientHandler& client) {
+        for (size_t i = 1; i < kClients; i += 2)
+        {
+            if (client.GetClientId() == ids[i]) return true;
+        }
+        return false;
+    });
+
+    if (even_result.sent != (kClients + 1) / 2 || odd_result.sent != kClients / 2) ok = false;
+
+    for (size_t i = 0; i < kClients; ++i) expected[i].push_back(i % 2 == 0 ? to_even : to_odd);
+
+    if (!ok) std::cout << "ERROR: " << title << ": broadcast results are off!\n";
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        if (!receivers[i].Expect(expected[i], framing))
+        {
+            std::cout << "ERROR: " << title << ": client " << i
+                      << " did not get every payload exactly once!\n";
+            ok = false;
+        }
+    }
+
+    if (ok) std::cout << title << ": " << kBroadcasts + 1 << " payloads to each of " << kClients
+                      << " clients\n";
+
+    clients.clear();
+    server->Stop();
+
+    return ok;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from BroadcastTest!\n";
+
+    Backend backend = Backend::kEpoll;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    bool stream = Run(argc, argv, backend, false, "Stream ");
+    bool framed = Run(argc, argv, backend, true, "Framing");
+
+    if (!stream || !framed) return EXIT_FAILURE;
+
+    std::cout << "Successfull broadcasts!\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <string>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Pushes multi-megabyte bursts in both directions and checks that every burst is fully
+// delivered shortly after it was sent, without any further data to "push" it through.
+//
+constexpr size_t kBurstSize = 4 * 1024 * 1024;
+constexpr int kBursts = 4;
+constexpr auto kBurstTimeout = 2s;
+constexpr size_t kPatternPeriod = 251;
+constexpr char kIoUringOption[] = "--io-uring";
+
+class Receiver
+{
+public:
+    void OnData(DataView data)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+
+        for (uint8_t byte : data)
+        {
+            if (byte != static_cast<uint8_t>((received_ % kBurstSize) % kPatternPeriod))
+                corrupted_ = true;
+            ++received_;
+        }
+
+        cv_.notify_all();
+    }
+
+    bool WaitFor(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        return cv_.wait_for(lk, kBurstTimeout, [&]() { return received_ >= bytes; }) &&
+               received_ == bytes && !corrupted_;
+    }
+
+    size_t GetReceived()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return received_;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    size_t received_ = 0;
+    bool corrupted_ = false;
+};
+
+int main(int argc, char const* argv[])
+{
+    nkhlab::libsercli::IServerPtr server;
+    nkhlab::libsercli::IClientPtr client;
+
+    std::cout << "Hello World from BurstTest!\n";
+
+    ServerConfig server_config;
+    ClientConfig client_config;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        server_config.backend = Backend::kIoUring;
+        client_config.backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
+    if (argc == 2)
+    {
+        const char* socket_path = argv[1];
+
+        server = CreateUnixServer(socket_path, server_config);
+        client = CreateUnixClient(socket_path, client_config);
+    }
+    else if (argc == 3)
+    {
+        const char* inet_address = argv[1];
+        int inet_port = atoi(argv[2]);
+
+        server = CreateInetServer(inet_address, inet_port, server_config);
+        client = CreateInetClient(inet_address, inet_port, client_config);
+    }
+    else
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!server || !client)
+    {
+        std::cout << "ERROR: server or client is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    Receiver server_receiver;
+    Receiver client_receiver;
+
+    std::mutex connected_m;
+    std::condition_variable connected_cv;
+    IClientHandlerPtr connected_client;
+
+    ClientStatusCb client_status_cb = [&](IClientHandlerPtr client, bool connected) {
+        if (connected)
+        {
+            {
+                std::lock_guard<std::mutex> lk(connected_m);
+                connected_client = client;
+            }
+            connected_cv.notify_all();
+        }
+    };
+
+    ServerDataViewReceivedCb server_data_received_cb =
+        [&](IClientHandlerPtr client, DataView data) {
+            static_cast<void>(client);
+            server_receiver.OnData(data);
+        };
+
+    if (!server->Start(client_status_cb, server_data_received_cb))
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    ClientDataViewReceivedCb client_data_received_cb = [&](DataView data) {
+        client_receiver.OnData(data);
+    };
+
+    if (!client->Connect([]() {}, client_data_received_cb))
+    {
+        std::cout << "ERROR: client failed on connect!\n";
+        return EXIT_FAILURE;
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(connected_m);
+        if (!connected_cv.wait_for(lk, 5s, [&]() { return connected_client != nullptr; }))
+        {
+            std::cout << "ERROR: Timeout reached no client connected!\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<uint8_t> burst(kBurstSize);
+    for (size_t i = 0; i < burst.size(); ++i) burst[i] = static_cast<uint8_t>(i % kPatternPeriod);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 1; i <= kBursts; ++i)
+    {
+        if (!client->Send(burst) || !server_receiver.WaitFor(i * kBurstSize))
+        {
+            std::cout << "ERROR: Client to Server burst " << i << " stalled at "
+                      << server_receiver.GetReceived() << " bytes!\n";
+            return EXIT_FAILURE;
+        }
+
+        if (!connected_client->Send(burst) || !client_receiver.WaitFor(i * kBurstSize))
+        {
+            std::cout << "ERROR: Server to Client burst " << i << " stalled at "
+                      << client_receiver.GetReceived() << " bytes!\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::cout << "Transferred " << 2 * kBursts * kBurstSize << " bytes in " << elapsed.count()
+              << " ms\n";
+    std::cout << "Successfull bursts!\n";
+
+    // Client closes first, so the server port is not left in TIME_WAIT
+    client.reset();
+    server->Stop();
+
+    return EXIT_SUCCESS;
+}
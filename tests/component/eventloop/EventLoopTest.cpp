@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Clients sharing the threads of one event loop, each must get exactly its own echo back.
+// Then clients that disconnect from their own data callback, on the loop and on a thread of
+// their own: no data must be delivered after that and the others have to keep working.
+//
+constexpr size_t kThreads = 2;
+constexpr size_t kClients = 8;
+constexpr size_t kRounds = 100;
+constexpr auto kTimeout = 2s;
+constexpr auto kQuietTime = 100ms;
+
+class Receiver
+{
+public:
+    void OnData(DataView data)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            received_.insert(received_.end(), data.begin(), data.end());
+            ++messages_;
+        }
+        cv_.notify_all();
+    }
+
+    bool WaitFor(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return cv_.wait_for(lk, kTimeout, [&]() { return received_.size() >= bytes; });
+    }
+
+    // Nothing more comes in for a while
+    bool StaysAt(size_t messages)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return !cv_.wait_for(lk, kQuietTime, [&]() { return messages_ > messages; }) &&
+               messages_ == messages;
+    }
+
+    std::string GetReceived()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return std::string(received_.begin(), received_.end());
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<uint8_t> received_;
+    size_t messages_ = 0;
+};
+
+class Endpoint
+{
+public:
+    Endpoint(int argc, char const* argv[])
+        : argc_{argc}
+        , argv_{argv}
+    {
+    }
+
+    IServerPtr CreateServer(const ServerConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixServer(argv_[1], config)
+                          : CreateInetServer(argv_[1], atoi(argv_[2]), config);
+    }
+
+    IClientPtr CreateClient(const ClientConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixClient(argv_[1], config)
+                          : CreateInetClient(argv_[1], atoi(argv_[2]), config);
+    }
+
+private:
+    const int argc_;
+    char const** const argv_;
+};
+
+std::vector<uint8_t> ToBytes(const std::string& str)
+{
+    return std::vector<uint8_t>(str.begin(), str.end());
+}
+
+bool TestSharedLoop(const Endpoint& endpoint, const IClientEventLoopPtr& event_loop)
+{
+    ClientConfig config;
+    config.event_loop = event_loop;
+
+    // Destroyed after the clients
+    std::vector<Receiver> receivers(kClients);
+    std::vector<IClientPtr> clients;
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        clients.push_back(endpoint.CreateClient(config));
+
+        Receiver& receiver = receivers[i];
+        if (!clients[i] || !clients[i]->Connect([]() {}, [&](DataView data) {
+                receiver.OnData(data);
+            }))
+            return false;
+    }
+
+    // All clients at once, each message names its client
+    std::string expected[kClients];
+
+    for (size_t round = 0; round < kRounds; ++round)
+    {
+        for (size_t i = 0; i < kClients; ++i)
+        {
+            std::string message = "<" + std::to_string(i) + ":" + std::to_string(round) + ">";
+
+            if (!clients[i]->Send(ToBytes(message))) return false;
+            expected[i] += message;
+        }
+    }
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        if (!receivers[i].WaitFor(expected[i].size()) || receivers[i].GetReceived() != expected[i])
+            return false;
+    }
+
+    return true;
+}
+
+bool TestDisconnectFromCallback(const Endpoint& endpoint, const IClientEventLoopPtr& event_loop)
+{
+    // Framing keeps the echoes apart, the server echoes a frame three times in one send
+    ClientConfig config;
+    config.event_loop = event_loop;
+    config.framing.enabled = true;
+
+    Receiver receiver;
+    IClientPtr client = endpoint.CreateClient(config);
+
+    if (!client) return false;
+
+    IClient* self = client.get();
+
+    if (!client->Connect([]() {}, [&receiver, self](DataView data) {
+            receiver.OnData(data);
+            self->Disconnect();
+        }))
+        return false;
+
+    if (!client->Send(ToBytes("disconnect me")) || !receiver.WaitFor(1) || !receiver.StaysAt(1))
+        return false;
+
+    // Its thread, if any, ended on its own meanwhile
+    client.reset();
+
+    return true;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from EventLoopTest!\n";
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: <unix socket path>\n";
+        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    Endpoint endpoint(argc, argv);
+
+    // Echoes data as is, framed data (a length header starts with 0) three times in one send
+    auto server = endpoint.CreateServer(ServerConfig());
+
+    if (!server)
+    {
+        std::cout << "ERROR: server is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!server->Start(
+            [](IClientHandlerPtr, bool) {},
+            [](IClientHandlerPtr client, DataView data) {
+                if (data.size() > 0 && *data.begin() == 0)
+                    client->Send({data, data, data});
+                else
+                    client->Send({data});
+            }))
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    auto event_loop = CreateClientEventLoop(kThreads);
+    if (!event_loop)
+    {
+        std::cout << "ERROR: event loop is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+
+    if (!TestSharedLoop(endpoint, event_loop))
+    {
+        std::cout << "ERROR: clients on one loop did not get their own echoes!\n";
+        ok = false;
+    }
+    if (!TestDisconnectFromCallback(endpoint, event_loop))
+    {
+        std::cout << "ERROR: disconnect from a callback on the loop failed!\n";
+        ok = false;
+    }
+    if (!TestDisconnectFromCallback(endpoint, nullptr))
+    {
+        std::cout << "ERROR: disconnect from a callback on the client's own thread failed!\n";
+        ok = false;
+    }
+    if (!TestSharedLoop(endpoint, event_loop))
+    {
+        std::cout << "ERROR: clients on one loop did not get their own echoes after disconnects!\n";
+        ok = false;
+    }
+
+    server->Stop();
+
+    if (!ok) return EXIT_FAILURE;
+
+    std::cout << "Successfull event loop!\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// A server running its data callbacks on a callback executor, slow enough for the work to pile
+// up: clients send numbered messages at once and leave right away. Each client's messages must
+// come in order, different clients in parallel, a client's disconnection after its last message.
+// Stop() comes while most are still queued, they must all run before it returns and none after.
+//
+constexpr char kIoUringOption[] = "--io-uring";
+constexpr size_t kExecutorThreads = 4;
+constexpr size_t kClients = 8;
+constexpr size_t kMessages = 50;
+constexpr auto kCallbackTime = 1ms;
+constexpr auto kReadTime = 50ms; // for the server to read all, far less than the callbacks take
+constexpr auto kQuietTime = 100ms;
+
+// What the server's callbacks saw
+class Recorder
+{
+public:
+    void OnData(IClientHandlerPtr client, DataView data)
+    {
+        if (data.size() != 2) return;
+
+        size_t running;
+
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            running = ++running_;
+            max_running_ = std::max(max_running_, running);
+        }
+
+        std::this_thread::sleep_for(kCallbackTime);
+
+        std::lock_guard<std::mutex> lk(m_);
+        --running_;
+
+        size_t index = *data.begin();
+        if (index >= kClients) return;
+
+        indexes_[client->GetClientId()] = index;
+        messages_[index].push_back(*(data.begin() + 1));
+        ++total_;
+    }
+
+    void OnStatus(IClientHandlerPtr client, bool connected)
+    {
+        if (connected) return;
+
+        std::lock_guard<std::mutex> lk(m_);
+
+        auto it = indexes_.find(client->GetClientId());
+        if (it != indexes_.end()) disconnected_at_[it->second] = messages_[it->second].size();
+    }
+
+    size_t GetTotal()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return total_;
+    }
+
+    size_t GetMaxRunning()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return max_running_;
+    }
+
+    // Messages in the order sent, disconnection after the last one
+    bool IsInOrder()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+
+        for (size_t index = 0; index < kClients; ++index)
+        {
+            const auto& messages = messages_[index];
+
+            if (messages.size() != kMessages) return false;
+
+            for (size_t i = 0; i < messages.size(); ++i)
+            {
+                if (messages[i] != i) return false;
+            }
+
+            auto it = disconnected_at_.find(index);
+            if (it == disconnected_at_.end() || it->second != kMessages) return false;
+        }
+
+        return true;
+    }
+
+private:
+    std::mutex m_;
+    std::map<ClientId, size_t> indexes_;
+    std::vector<size_t> messages_[kClients];
+    std::map<size_t, size_t> disconnected_at_; // by index, the messages received by then
+    size_t total_ = 0;
+    size_t running_ = 0;
+    size_t max_running_ = 0;
+};
+
+class Endpoint
+{
+public:
+    Endpoint(int argc, char const* argv[])
+        : argc_{argc}
+        , argv_{argv}
+    {
+    }
+
+    IServerPtr CreateServer(const ServerConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixServer(argv_[1], config)
+                          : CreateInetServer(argv_[1], atoi(argv_[2]), config);
+    }
+
+    IClientPtr CreateClient(const ClientConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixClient(argv_[1], config)
+                          : CreateInetClient(argv_[1], atoi(argv_[2]), config);
+    }
+
+private:
+    const int argc_;
+    char const** const argv_;
+};
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from ExecutorTest!\n";
+
+    Backend backend = Backend::kEpoll;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    Endpoint endpoint(argc, argv);
+
+    // Framing keeps the messages apart
+    ServerConfig server_config;
+    server_config.backend = backend;
+    server_config.framing.enabled = true;
+    server_config.callback_executor.threads = kExecutorThreads;
+
+    // On epoll the clients write at once, so they can leave right after sending
+    ClientConfig client_config;
+    client_config.framing.enabled = true;
+
+    auto server = endpoint.CreateServer(server_config);
+
+    if (!server)
+    {
+        std::cout << "ERROR: server is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    Recorder recorder;
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr client, bool connected) { recorder.OnStatus(client, connected); },
+        [&](IClientHandlerPtr client, DataView data) { recorder.OnData(client, data); });
+
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<IClientPtr> clients;
+
+    for (size_t i = 0; i < kClients; ++i)
+    {
+        clients.push_back(endpoint.CreateClient(client_config));
+
+        if (!clients[i] || !clients[i]->Connect([]() {}, [](DataView) {}))
+        {
+            std::cout << "ERROR: client " << i << " failed to connect!\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // All clients at once, each message names its client
+    for (size_t seq = 0; seq < kMessages; ++seq)
+    {
+        for (size_t i = 0; i < kClients; ++i)
+        {
+            if (!clients[i]->Send({static_cast<uint8_t>(i), static_cast<uint8_t>(seq)}))
+            {
+                std::cout << "ERROR: client " << i << " failed to send!\n";
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    clients.clear();
+
+    std::this_thread::sleep_for(kReadTime);
+
+    size_t before_stop = recorder.GetTotal();
+
+    server->Stop();
+
+    size_t after_stop = recorder.GetTotal();
+
+    std::this_thread::sleep_for(kQuietTime);
+
+    bool ok = true;
+
+    if (after_stop != kClients * kMessages)
+    {
+        std::cout << "ERROR: " << after_stop << " of " << kClients * kMessages
+                  << " callbacks ran by the time Stop() returned!\n";
+        ok = false;
+    }
+    if (recorder.GetTotal() != after_stop)
+    {
+        std::cout << "ERROR: callbacks ran after Stop() returned!\n";
+        ok = false;
+    }
+    if (!recorder.IsInOrder())
+    {
+        std::cout << "ERROR: messages or disconnections of a client out of order!\n";
+        ok = false;
+    }
+    if (recorder.GetMaxRunning() < 2)
+    {
+        std::cout << "ERROR: callbacks of different clients did not run in parallel!\n";
+        ok = false;
+    }
+
+    if (!ok) return EXIT_FAILURE;
+
+    std::cout << "Stop() drained " << after_stop - before_stop << " queued callbacks\n";
+    std::cout << "Successfull executor!\n";
+
+    return EXIT_SUCCESS;
+}
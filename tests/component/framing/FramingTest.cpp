@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// A server with framing on, fed by clients with framing off that write the frames by hand, so
+// the chunks the server reads can be chosen: a frame split over several chunks, several frames
+// in one chunk and a frame over the limit. Then sends of more parts than a frame keeps inline,
+// between the server and a client with framing on.
+//
+constexpr size_t kMaxFrameSize = 1024;
+constexpr size_t kManyParts = 20;
+constexpr auto kChunkDelay = 50ms;
+constexpr auto kTimeout = 2s;
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes Payload(size_t size, uint8_t seed)
+{
+    Bytes payload(size);
+    for (size_t i = 0; i < size; ++i) payload[i] = static_cast<uint8_t>(seed + i);
+    return payload;
+}
+
+Bytes Frame(const Bytes& payload)
+{
+    size_t size = payload.size();
+    Bytes frame{
+        static_cast<uint8_t>(size >> 24),
+        static_cast<uint8_t>(size >> 16),
+        static_cast<uint8_t>(size >> 8),
+        static_cast<uint8_t>(size)};
+
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+// What one side received
+class Peer
+{
+public:
+    void OnConnected(IClientHandlerPtr client)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        client_ = client;
+    }
+
+    IClientHandlerPtr GetClient()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return client_;
+    }
+
+    void OnData(DataView data)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            messages_.emplace_back(data.begin(), data.end());
+        }
+        cv_.notify_all();
+    }
+
+    void OnDisconnected()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            ++disconnected_;
+        }
+        cv_.notify_all();
+    }
+
+    // Exactly expected is received, and nothing more shortly after
+    bool Expect(const std::vector<Bytes>& expected)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        cv_.wait_for(lk, kTimeout, [&]() { return messages_.size() >= expected.size(); });
+        cv_.wait_for(lk, kChunkDelay, [&]() { return messages_.size() > expected.size(); });
+
+        bool ok = messages_ == expected;
+        messages_.clear();
+
+        return ok;
+    }
+
+    bool WaitDisconnected()
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        bool ok = cv_.wait_for(lk, kTimeout, [&]() { return disconnected_ > 0; });
+        disconnected_ = 0;
+
+        return ok;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<Bytes> messages_;
+    size_t disconnected_ = 0;
+    IClientHandlerPtr client_; // last one connected, on the server side
+};
+
+class Endpoint
+{
+public:
+    Endpoint(int argc, char const* argv[])
+        : argc_{argc}
+        , argv_{argv}
+    {
+    }
+
+    IServerPtr CreateServer(const ServerConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixServer(argv_[1], config)
+                          : CreateInetServer(argv_[1], atoi(argv_[2]), config);
+    }
+
+    IClientPtr CreateClient(const ClientConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixClient(argv_[1], config)
+                          : CreateInetClient(argv_[1], atoi(argv_[2]), config);
+    }
+
+private:
+    const int argc_;
+    char const** const argv_;
+};
+
+// Writes chunks apart from each other, so the server reads them one by one
+bool SendChunks(IClient& client, const Bytes& data, const std::vector<size_t>& chunk_sizes)
+{
+    size_t pos = 0;
+
+    for (size_t size : chunk_sizes)
+    {
+        if (!client.Send(Bytes(data.begin() + pos, data.begin() + pos + size))) return false;
+        pos += size;
+        std::this_thread::sleep_for(kChunkDelay);
+    }
+
+    return pos == data.size();
+}
+
+bool TestSplitFrame(const Endpoint& endpoint, Peer& server)
+{
+    auto client = endpoint.CreateClient(ClientConfig());
+    if (!client || !client->Connect([]() {}, [](DataView) {})) return false;
+
+    Bytes payload = Payload(100, 1);
+
+    // The header split too, then the payload in two
+    return SendChunks(*client, Frame(payload), {1, 3, 40, 60}) && server.Expect({payload});
+}
+
+bool TestFramesInOneChunk(const Endpoint& endpoint, Peer& server)
+{
+    auto client = endpoint.CreateClient(ClientConfig());
+    if (!client || !client->Connect([]() {}, [](DataView) {})) return false;
+
+    std::vector<Bytes> payloads = {Payload(10, 2), Payload(kMaxFrameSize, 3), Bytes(), Payload(1, 4)};
+
+    Bytes chunk;
+    for (auto& payload : payloads)
+    {
+        Bytes frame = Frame(payload);
+        chunk.insert(chunk.end(), frame.begin(), frame.end());
+    }
+
+    // The last frame also ends the next chunk half way
+    Bytes last = Frame(Payload(50, 5));
+    chunk.insert(chunk.end(), last.begin(), last.begin() + 20);
+
+    if (!SendChunks(*client, chunk, {chunk.size()}) || !server.Expect(payloads))
+        return false;
+
+    return SendChunks(*client, Bytes(last.begin() + 20, last.end()), {last.size() - 20}) &&
+           server.Expect({Payload(50, 5)});
+}
+
+bool TestOversizedFrame(const Endpoint& endpoint, Peer& server)
+{
+    Peer client_events;
+
+    auto client = endpoint.CreateClient(ClientConfig());
+    if (!client || !client->Connect([&]() { client_events.OnDisconnected(); }, [](DataView) {}))
+        return false;
+
+    // Only the header, the server can't follow the stream from there and closes it
+    Bytes header = Frame(Bytes());
+    header[1] = 0x10;
+
+    return SendChunks(*client, header, {header.size()}) && client_events.WaitDisconnected() &&
+           server.Expect({});
+}
+
+bool TestManyParts(const Endpoint& endpoint, Peer& server)
+{
+    ClientConfig config;
+    config.framing.enabled = true;
+    config.framing.max_frame_size = kMaxFrameSize;
+
+    Peer client_messages;
+
+    auto client = endpoint.CreateClient(config);
+    if (!client || !client->Connect([]() {}, [&](DataView data) { client_messages.OnData(data); }))
+        return false;
+
+    Bytes payload = Payload(kManyParts * 3, 6);
+
+    std::vector<DataView> parts;
+    for (size_t i = 0; i < kManyParts; ++i) parts.emplace_back(&payload[i * 3], 3);
+
+    if (!client->Send(parts.data(), parts.size(), nullptr) || !server.Expect({payload}))
+        return false;
+
+    // Its data came in, so the client is the last one connected by now
+    auto connected = server.GetClient();
+
+    return connected && connected->Send(parts.data(), parts.size(), nullptr) &&
+           client_messages.Expect({payload});
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from FramingTest!\n";
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: <unix socket path>\n";
+        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    Endpoint endpoint(argc, argv);
+
+    ServerConfig config;
+    config.framing.enabled = true;
+    config.framing.max_frame_size = kMaxFrameSize;
+
+    auto server = endpoint.CreateServer(config);
+    if (!server)
+    {
+        std::cout << "ERROR: server is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    Peer server_peer;
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr client, bool connected) {
+            if (connected) server_peer.OnConnected(client);
+        },
+        [&](IClientHandlerPtr, DataView data) { server_peer.OnData(data); });
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+
+    if (!TestSplitFrame(endpoint, server_peer))
+    {
+        std::cout << "ERROR: frame split over chunks is not delivered whole!\n";
+        ok = false;
+    }
+    if (!TestFramesInOneChunk(endpoint, server_peer))
+    {
+        std::cout << "ERROR: frames in one chunk are not delivered one by one!\n";
+        ok = false;
+    }
+    if (!TestOversizedFrame(endpoint, server_peer))
+    {
+        std::cout << "ERROR: frame over the limit does not disconnect the client!\n";
+        ok = false;
+    }
+
+    if (!TestManyParts(endpoint, server_peer))
+    {
+        std::cout << "ERROR: send of " << kManyParts << " parts is not delivered as one frame!\n";
+        ok = false;
+    }
+
+    server_peer.OnConnected(nullptr);
+    server->Stop();
+
+    if (!ok) return EXIT_FAILURE;
+
+    std::cout << "Successfull framing!\n";
+
+    return EXIT_SUCCESS;
+}
@@ -11,7 +11,7 @@
 
 #include <condition_variable>
 #include <iostream>
-#include <thread>
+#include <string>
 
 #include "libsercli/ClientBuilder.h"
 #include "libsercli/ServerBuilder.h"
@@ -21,6 +21,7 @@ using namespace std::chrono_literals;
 
 constexpr char kHandshakeRequest[] = "Hello Client!";
 constexpr char kHandshakeReply[] = "Hello Server!";
+constexpr char kIoUringOption[] = "--io-uring";
 
 int main(int argc, char const* argv[])
 {
@@ -33,11 +34,30 @@ int main(int argc, char const* argv[])
 
     std::cout << "Hello World from HandshakeTest!\n";
 
+    ServerConfig server_config;
+    ClientConfig client_config;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        server_config.backend = Backend::kIoUring;
+        client_config.backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
     if (argc < 2)
     {
         std::cout << "No configuration provided! Please provide it as arguments.\n";
-        std::cout << "For UNIX socket connection: <unix socket path>\n";
-        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
         return EXIT_FAILURE;
     }
 
@@ -45,22 +65,22 @@ int main(int argc, char const* argv[])
     {
         const char* socket_path = argv[1];
 
-        server = CreateUnixServer(socket_path);
-        client = CreateUnixClient(socket_path);
+        server = CreateUnixServer(socket_path, server_config);
+        client = CreateUnixClient(socket_path, client_config);
     }
     else if (argc == 3)
     {
         const char* inet_address = argv[1];
         int inet_port = atoi(argv[2]);
 
-        server = CreateInetServer(inet_address, inet_port);
-        client = CreateInetClient(inet_address, inet_port);
+        server = CreateInetServer(inet_address, inet_port, server_config);
+        client = CreateInetClient(inet_address, inet_port, client_config);
     }
     else
     {
         std::cout << "Incorrect use of arguments. Please use as below:\n";
-        std::cout << "For UNIX socket connection: <unix socket path>\n";
-        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
         return EXIT_FAILURE;
     }
 
@@ -99,8 +119,6 @@ int main(int argc, char const* argv[])
     {
         if (server->Start(client_status_cb, server_data_received_cb))
         {
-            std::this_thread::sleep_for(100ms);
-
             if (client)
             {
                 ServerDisconnectedCb server_disconnected_cb = []() {
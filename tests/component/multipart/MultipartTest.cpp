@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Sends made of more parts than one sendmsg() takes, both ways and with framing off and on.
+// Every send must be delivered whole and in order, and its completion reported, without any
+// further data to "push" it through.
+//
+constexpr size_t kParts = 100;
+constexpr size_t kPartSize = 10;
+constexpr size_t kSendSize = kParts * kPartSize;
+constexpr size_t kSends = 4;
+constexpr auto kSendTimeout = 2s;
+constexpr size_t kPatternPeriod = 251;
+
+class Receiver
+{
+public:
+    void OnData(DataView data)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+
+            for (uint8_t byte : data)
+            {
+                if (byte != static_cast<uint8_t>((received_ % kSendSize) % kPatternPeriod))
+                    corrupted_ = true;
+                ++received_;
+            }
+
+            if (data.size() != kSendSize) whole_messages_ = false;
+        }
+        cv_.notify_all();
+    }
+
+    void OnCompleted(bool sent)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (sent) ++completed_;
+        }
+        cv_.notify_all();
+    }
+
+    // Completions are counted on the sending side's receiver
+    bool WaitFor(size_t bytes, size_t completed)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+
+        return cv_.wait_for(
+                   lk, kSendTimeout, [&]() { return received_ >= bytes && completed_ >= completed; }) &&
+               received_ == bytes && !corrupted_;
+    }
+
+    bool WholeMessages()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return whole_messages_;
+    }
+
+    size_t GetReceived()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return received_;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    size_t received_ = 0;
+    size_t completed_ = 0;
+    bool corrupted_ = false;
+    bool whole_messages_ = true;
+};
+
+bool Run(int argc, char const* argv[], bool framing, const std::string& title)
+{
+    ServerConfig server_config;
+    server_config.framing.enabled = framing;
+
+    ClientConfig client_config;
+    client_config.framing.enabled = framing;
+
+    IServerPtr server;
+    IClientPtr client;
+
+    if (argc == 2)
+    {
+        server = CreateUnixServer(argv[1], server_config);
+        client = CreateUnixClient(argv[1], client_config);
+    }
+    else
+    {
+        server = CreateInetServer(argv[1], atoi(argv[2]), server_config);
+        client = CreateInetClient(argv[1], atoi(argv[2]), client_config);
+    }
+
+    if (!server || !client)
+    {
+        std::cout << "ERROR: server or client is nullptr!\n";
+        return false;
+    }
+
+    Receiver server_receiver;
+    Receiver client_receiver;
+
+    std::mutex connected_m;
+    std::condition_variable connected_cv;
+    IClientHandlerPtr connected_client;
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr client, bool connected) {
+            if (!connected) return;
+            {
+                std::lock_guard<std::mutex> lk(connected_m);
+                connected_client = client;
+            }
+            connected_cv.notify_all();
+        },
+        [&](IClientHandlerPtr, DataView data) { server_receiver.OnData(data); });
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return false;
+    }
+
+    if (!client->Connect([]() {}, [&](DataView data) { client_receiver.OnData(data); }))
+    {
+        std::cout << "ERROR: client failed to connect!\n";
+        return false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(connected_m);
+        if (!connected_cv.wait_for(lk, 5s, [&]() { return connected_client != nullptr; }))
+        {
+            std::cout << "ERROR: Timeout reached no client connected!\n";
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> payload(kSendSize);
+    for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<uint8_t>(i % kPatternPeriod);
+
+    std::vector<DataView> parts;
+    for (size_t i = 0; i < kParts; ++i) parts.emplace_back(&payload[i * kPartSize], kPartSize);
+
+    bool ok = true;
+
+    for (size_t i = 1; ok && i <= kSends; ++i)
+    {
+        // Completion of the client's sends goes to the server's receiver, and the other way round
+        if (!client->Send(parts.data(), parts.size(), [&](bool sent) {
+                server_receiver.OnCompleted(sent);
+            }) ||
+            !server_receiver.WaitFor(i * kSendSize, i))
+        {
+            std::cout << "ERROR: " << title << ": Client to Server send " << i << " stalled at "
+                      << server_receiver.GetReceived() << " bytes!\n";
+            ok = false;
+        }
+        else if (
+            !connected_client->Send(parts.data(), parts.size(), [&](bool sent) {
+                client_receiver.OnCompleted(sent);
+            }) ||
+            !client_receiver.WaitFor(i * kSendSize, i))
+        {
+            std::cout << "ERROR: " << title << ": Server to Client send " << i << " stalled at "
+                      << client_receiver.GetReceived() << " bytes!\n";
+            ok = false;
+        }
+    }
+
+    if (ok && framing && (!server_receiver.WholeMessages() || !client_receiver.WholeMessages()))
+    {
+        std::cout << "ERROR: " << title << ": a send was not delivered as one frame!\n";
+        ok = false;
+    }
+
+    if (ok) std::cout << title << ": " << kSends << " sends of " << kParts << " parts each way\n";
+
+    connected_client.reset();
+    client.reset();
+    server->Stop();
+
+    return ok;
+}
+
+//
+// Empty sends with framing off, plain and scatter-gather, both ways: they have nothing to write,
+// yet succeed and leave the connection up. The server replies to "e" with empty sends only, so
+// with write coalescing the flush after its callbacks has nothing but them to write.
+//
+bool RunEmpty(int argc, char const* argv[], bool coalescing, const std::string& title)
+{
+    ServerConfig server_config;
+    ClientConfig client_config;
+
+    if (coalescing)
+    {
+        server_config.write_coalescing.max_bytes = 4096;
+        client_config.write_coalescing.max_bytes = 4096;
+    }
+
+    IServerPtr server;
+    IClientPtr client;
+
+    if (argc == 2)
+    {
+        server = CreateUnixServer(argv[1], server_config);
+        client = CreateUnixClient(argv[1], client_config);
+    }
+    else
+    {
+        server = CreateInetServer(argv[1], atoi(argv[2]), server_config);
+        client = CreateInetClient(argv[1], atoi(argv[2]), client_config);
+    }
+
+    if (!server || !client)
+    {
+        std::cout << "ERROR: server or client is nullptr!\n";
+        return false;
+    }
+
+    const std::vector<uint8_t> empty;
+    const DataView empty_parts[2];
+    const std::vector<uint8_t> pong{'p', 'o', 'n', 'g'};
+
+    std::mutex m;
+    std::condition_variable cv;
+    size_t server_disconnects = 0;
+    size_t client_disconnects = 0;
+    bool server_sent = true;
+    std::string received;
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr, bool connected) {
+            std::lock_guard<std::mutex> lk(m);
+            if (!connected) ++server_disconnects;
+        },
+        [&](IClientHandlerPtr client, DataView data) {
+            bool sent = std::string(data.begin(), data.end()) == "e"
+                            ? client->Send(empty) && client->Send(empty_parts, 2, nullptr)
+                            : client->Send(pong);
+
+            std::lock_guard<std::mutex> lk(m);
+            server_sent = server_sent && sent;
+        });
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return false;
+    }
+
+    auto client_disconnected = [&]() {
+        std::lock_guard<std::mutex> lk(m);
+        ++client_disconnects;
+    };
+
+    bool connected = client->Connect(client_disconnected, [&](DataView data) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            received.append(data.begin(), data.end());
+        }
+        cv.notify_all();
+    });
+
+    // Apart, so the server reads them in separate rounds
+    bool ok = connected && client->Send(empty) && client->Send(empty_parts, 2, nullptr) &&
+              client->Send(std::vector<uint8_t>{'e'});
+
+    std::this_thread::sleep_for(50ms);
+
+    ok = ok && client->Send(std::vector<uint8_t>{'x'});
+
+    if (!ok)
+    {
+        std::cout << "ERROR: " << title << ": client failed to send empty data!\n";
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lk(m);
+
+        // The connection stays up: nothing more comes, the server keeps its client
+        bool got = cv.wait_for(lk, kSendTimeout, [&]() { return received == "pong"; });
+        cv.wait_for(lk, 100ms, [&]() { return received != "pong"; });
+
+        if (!got || received != "pong" || !server_sent || server_disconnects != 0 ||
+            client_disconnects != 0)
+        {
+            std::cout << "ERROR: " << title << ": server failed to send empty data, "
+                      << "server-side disconnects=" << server_disconnects
+                      << ", client-side disconnects=" << client_disconnects << "!\n";
+            ok = false;
+        }
+    }
+
+    if (ok) std::cout << title << ": empty sends succeeded both ways\n";
+
+    client.reset();
+    server->Stop();
+
+    return ok;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from MultipartTest!\n";
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: <unix socket path>\n";
+        std::cout << "For Inet connection:        <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    bool stream = Run(argc, argv, false, "Stream ");
+    bool framed = Run(argc, argv, true, "Framing");
+    bool empty = RunEmpty(argc, argv, false, "Empty sends          ");
+    bool coalesced = RunEmpty(argc, argv, true, "Empty sends coalesced");
+
+    if (!stream || !framed || !empty || !coalesced) return EXIT_FAILURE;
+
+    std::cout << "Successfull multipart sends!\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2023 https://github.com/nkh-lab
+ *
+ * This is free software. You can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY.
+ */
+
+
+#include <dirent.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libsercli/ClientBuilder.h"
+#include "libsercli/ServerBuilder.h"
+
+using namespace nkhlab::libsercli;
+using namespace std::chrono_literals;
+
+//
+// Reading paused from the data callback, on the server and on a client: several frames come
+// in one chunk, only the first is delivered until reading is resumed, then one more each time.
+// Clients that leave while the server holds their frames back get them delivered on resuming,
+// then their disconnection, and leave no socket open behind.
+// Then the send watermarks of both sides: a peer that stops reading turns the sender
+// unwritable, and writable again once it reads the queue off.
+//
+constexpr char kIoUringOption[] = "--io-uring";
+constexpr char kEchoRequest[] = "echo";
+constexpr char kSlowRequest[] = "slow";
+constexpr size_t kHighWatermark = 256 * 1024;
+constexpr size_t kLowWatermark = 64 * 1024;
+constexpr size_t kChunkSize = 16 * 1024;
+constexpr size_t kMaxChunks = 4096;
+constexpr size_t kLeavingClients = 50;
+constexpr auto kTimeout = 5s;
+constexpr auto kQuietTime = 100ms;
+constexpr auto kSlowTime = 200ms; // the server's I/O thread is held up by a slow request
+
+using Bytes = std::vector<uint8_t>;
+
+const std::vector<std::string> kFrames{"one", "two", "three"};
+
+Bytes ToBytes(const std::string& str)
+{
+    return Bytes(str.begin(), str.end());
+}
+
+Bytes Frame(const std::string& payload)
+{
+    size_t size = payload.size();
+    Bytes frame{
+        static_cast<uint8_t>(size >> 24),
+        static_cast<uint8_t>(size >> 16),
+        static_cast<uint8_t>(size >> 8),
+        static_cast<uint8_t>(size)};
+
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+// What one side received and how its writability went
+class Peer
+{
+public:
+    void OnConnected(IClientHandlerPtr client)
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        client_ = client;
+        clients_.push_back(client);
+    }
+
+    void OnDisconnected()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            ++disconnections_;
+        }
+        cv_.notify_all();
+    }
+
+    // All connected since Clear()
+    std::vector<IClientHandlerPtr> GetClients()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return clients_;
+    }
+
+    bool WaitForDisconnections(size_t count)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return cv_.wait_for(lk, kTimeout, [&]() { return disconnections_ >= count; });
+    }
+
+    IClientHandlerPtr GetClient()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return client_;
+    }
+
+    void OnData(DataView data)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            messages_.emplace_back(data.begin(), data.end());
+        }
+        cv_.notify_all();
+    }
+
+    void OnWritable(bool writable)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            writable_changes_.push_back(writable);
+        }
+        cv_.notify_all();
+    }
+
+    void SetPauseOnData(bool pause) { pause_on_data_ = pause; }
+    bool PausesOnData() const { return pause_on_data_; }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        messages_.clear();
+        writable_changes_.clear();
+        clients_.clear();
+        disconnections_ = 0;
+    }
+
+    bool WaitForMessages(size_t count)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return cv_.wait_for(lk, kTimeout, [&]() { return messages_.size() >= count; });
+    }
+
+    // Nothing more comes in for a while
+    bool StaysAt(size_t count)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return !cv_.wait_for(lk, kQuietTime, [&]() { return messages_.size() > count; }) &&
+               messages_.size() == count;
+    }
+
+    std::vector<std::string> GetMessages()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return messages_;
+    }
+
+    // The last change reported is to writable
+    bool WaitForWritable(bool writable)
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        return cv_.wait_for(lk, kTimeout, [&]() {
+            return !writable_changes_.empty() && writable_changes_.back() == writable;
+        });
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    IClientHandlerPtr client_;
+    std::vector<IClientHandlerPtr> clients_;
+    size_t disconnections_ = 0;
+    std::vector<std::string> messages_;
+    std::vector<bool> writable_changes_;
+    std::atomic_bool pause_on_data_{false};
+};
+
+class Endpoint
+{
+public:
+    Endpoint(int argc, char const* argv[])
+        : argc_{argc}
+        , argv_{argv}
+    {
+    }
+
+    IServerPtr CreateServer(const ServerConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixServer(argv_[1], config)
+                          : CreateInetServer(argv_[1], atoi(argv_[2]), config);
+    }
+
+    IClientPtr CreateClient(const ClientConfig& config) const
+    {
+        return argc_ == 2 ? CreateUnixClient(argv_[1], config)
+                          : CreateInetClient(argv_[1], atoi(argv_[2]), config);
+    }
+
+private:
+    const int argc_;
+    char const** const argv_;
+};
+
+bool TestServerPause(const Endpoint& endpoint, Peer& server, ClientConfig config)
+{
+    // Framing off, the frames are written by hand all in one chunk
+    config.framing.enabled = false;
+
+    auto client = endpoint.CreateClient(config);
+    if (!client || !client->Connect([]() {}, [](DataView) {})) return false;
+
+    Bytes chunk;
+    for (auto& payload : kFrames)
+    {
+        Bytes frame = Frame(payload);
+        chunk.insert(chunk.end(), frame.begin(), frame.end());
+    }
+
+    server.Clear();
+    server.SetPauseOnData(true);
+
+    if (!client->Send(chunk) || !server.WaitForMessages(1) || !server.StaysAt(1)) return false;
+
+    // Its data came in, so the client is the last one connected by now
+    auto connected = server.GetClient();
+
+    for (size_t count = 2; count <= kFrames.size(); ++count)
+    {
+        connected->ResumeReading();
+        if (!server.WaitForMessages(count) || !server.StaysAt(count)) return false;
+    }
+
+    // Reading goes on as usual once resumed for good
+    server.SetPauseOnData(false);
+    connected->ResumeReading();
+
+    std::vector<std::string> expected = kFrames;
+    expected.push_back("four");
+
+    return client->Send(Frame("four")) && server.WaitForMessages(expected.size()) &&
+           server.GetMessages() == expected;
+}
+
+size_t CountOpenFds()
+{
+    size_t count = 0;
+
+    if (DIR* dir = opendir("/proc/self/fd"))
+    {
+        while (readdir(dir)) ++count;
+        closedir(dir);
+    }
+
+    return count;
+}
+
+bool TestServerPauseLeaving(const Endpoint& endpoint, Peer& server, ClientConfig config)
+{
+    // Framing off, the frames are written by hand all in one chunk. The clients leave right
+    // after sending, the epoll ones have written it all by then.
+    config.framing.enabled = false;
+    config.backend = Backend::kEpoll;
+
+    Bytes chunk;
+    for (auto& payload : kFrames)
+    {
+        Bytes frame = Frame(payload);
+        chunk.insert(chunk.end(), frame.begin(), frame.end());
+    }
+
+    // Connections of the earlier tests are gone by now
+    std::this_thread::sleep_for(kQuietTime);
+
+    server.Clear();
+    server.SetPauseOnData(true);
+
+    size_t fds = CountOpenFds();
+
+    std::vector<IClientPtr> clients;
+
+    for (size_t i = 0; i < kLeavingClients; ++i)
+    {
+        clients.push_back(endpoint.CreateClient(config));
+        if (!clients.back() || !clients.back()->Connect([]() {}, [](DataView) {})) return false;
+    }
+
+    //
+    // While a slow request holds the server up, all send and leave: their data and their
+    // disconnection come in together, so they are gone before the server pauses reading
+    //
+    auto slow = endpoint.CreateClient(config);
+    if (!slow || !slow->Connect([]() {}, [](DataView) {}) || !slow->Send(Frame(kSlowRequest)) ||
+        !server.WaitForMessages(1))
+        return false;
+
+    for (auto& client : clients)
+    {
+        if (!client->Send(chunk)) return false;
+    }
+
+    clients.clear();
+
+    // Each one paused on its first frame, the rest is held back
+    if (!server.WaitForMessages(1 + kLeavingClients) || !server.StaysAt(1 + kLeavingClients))
+        return false;
+
+    slow.reset();
+    server.SetPauseOnData(false);
+
+    for (auto& client : server.GetClients()) client->ResumeReading();
+
+    if (!server.WaitForMessages(1 + kLeavingClients * kFrames.size()) ||
+        !server.WaitForDisconnections(1 + kLeavingClients))
+        return false;
+
+    server.Clear();
+
+    // Sockets of the connections are closed once they are gone
+    for (auto start = std::chrono::steady_clock::now();
+         std::chrono::steady_clock::now() - start < kTimeout;
+         std::this_thread::sleep_for(10ms))
+    {
+        if (CountOpenFds() == fds) return true;
+    }
+
+    std::cout << "ERROR: " << CountOpenFds() - fds << " sockets left open!\n";
+    return false;
+}
+
+bool TestClientPause(const Endpoint& endpoint, ClientConfig config)
+{
+    // The server replies to the request with all the frames in one chunk
+    config.framing.enabled = true;
+
+    // Destroyed after the client
+    Peer peer;
+    auto client = endpoint.CreateClient(config);
+    if (!client) return false;
+
+    IClient* self = client.get();
+
+    if (!client->Connect([]() {}, [&peer, self](DataView data) {
+            peer.OnData(data);
+            self->PauseReading();
+        }))
+        return false;
+
+    if (!client->Send(ToBytes(kEchoRequest)) || !peer.WaitForMessages(1) || !peer.StaysAt(1))
+        return false;
+
+    for (size_t count = 2; count <= kFrames.size(); ++count)
+    {
+        client->ResumeReading();
+        if (!peer.WaitForMessages(count) || !peer.StaysAt(count)) return false;
+    }
+
+    return peer.GetMessages() == kFrames;
+}
+
+bool TestServerWatermarks(const Endpoint& endpoint, Peer& server, ClientConfig config)
+{
+    config.framing.enabled = true;
+
+    Peer peer;
+    auto client = endpoint.CreateClient(config);
+    if (!client || !client->Connect([]() {}, [&](DataView data) { peer.OnData(data); }))
+        return false;
+
+    server.Clear();
+
+    if (!client->Send(ToBytes("hello")) || !server.WaitForMessages(1)) return false;
+
+    auto connected = server.GetClient();
+
+    // The kernel buffers fill up first, then the server's queue
+    client->PauseReading();
+
+    Bytes chunk(kChunkSize, 's');
+    size_t sent = 0;
+
+    while (connected->IsWritable())
+    {
+        if (sent == kMaxChunks || !connected->Send(chunk)) return false;
+        ++sent;
+    }
+
+    if (!server.WaitForWritable(false)) return false;
+
+    client->ResumeReading();
+
+    return peer.WaitForMessages(sent) && server.WaitForWritable(true);
+}
+
+bool TestClientWatermarks(const Endpoint& endpoint, Peer& server, ClientConfig config)
+{
+    config.framing.enabled = true;
+    config.send_watermarks.high = kHighWatermark;
+    config.send_watermarks.low = kLowWatermark;
+
+    Peer peer;
+    auto client = endpoint.CreateClient(config);
+    if (!client) return false;
+
+    client->SetWritableCb([&](bool writable) { peer.OnWritable(writable); });
+
+    if (!client->Connect([]() {}, [](DataView) {})) return false;
+
+    server.Clear();
+
+    if (!client->Send(ToBytes("hello")) || !server.WaitForMessages(1)) return false;
+
+    auto connected = server.GetClient();
+
+    connected->PauseReading();
+
+    Bytes chunk(kChunkSize, 'c');
+    size_t sent = 0;
+
+    while (client->IsWritable())
+    {
+        if (sent == kMaxChunks || !client->Send(chunk)) return false;
+        ++sent;
+    }
+
+    if (!peer.WaitForWritable(false)) return false;
+
+    connected->ResumeReading();
+
+    return server.WaitForMessages(1 + sent) && peer.WaitForWritable(true);
+}
+
+int main(int argc, char const* argv[])
+{
+    std::cout << "Hello World from PauseTest!\n";
+
+    Backend backend = Backend::kEpoll;
+
+    // Optional first argument selects the io_uring backend, skipped where it can't run
+    if (argc > 1 && std::string(argv[1]) == kIoUringOption)
+    {
+        if (!IsBackendSupported(Backend::kIoUring))
+        {
+            std::cout << "io_uring is not supported here, skipped\n";
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Running on the io_uring backend\n";
+        backend = Backend::kIoUring;
+        --argc;
+        ++argv;
+    }
+
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Incorrect use of arguments. Please use as below:\n";
+        std::cout << "For UNIX socket connection: [--io-uring] <unix socket path>\n";
+        std::cout << "For Inet connection:        [--io-uring] <inet address> <inet port>\n";
+        return EXIT_FAILURE;
+    }
+
+    Endpoint endpoint(argc, argv);
+
+    // Replies to a request go out together once the callback returns
+    ServerConfig server_config;
+    server_config.backend = backend;
+    server_config.framing.enabled = true;
+    server_config.write_coalescing.max_bytes = 4096;
+    server_config.send_watermarks.high = kHighWatermark;
+    server_config.send_watermarks.low = kLowWatermark;
+
+    ClientConfig client_config;
+    client_config.backend = backend;
+
+    auto server = endpoint.CreateServer(server_config);
+
+    if (!server)
+    {
+        std::cout << "ERROR: server is nullptr!\n";
+        return EXIT_FAILURE;
+    }
+
+    Peer server_peer;
+
+    server->SetClientWritableCb(
+        [&](IClientHandlerPtr, bool writable) { server_peer.OnWritable(writable); });
+
+    bool started = server->Start(
+        [&](IClientHandlerPtr client, bool connected) {
+            if (connected)
+                server_peer.OnConnected(client);
+            else
+                server_peer.OnDisconnected();
+        },
+        [&](IClientHandlerPtr client, DataView data) {
+            server_peer.OnData(data);
+            if (server_peer.PausesOnData()) client->PauseReading();
+
+            if (std::string(data.begin(), data.end()) == kSlowRequest)
+                std::this_thread::sleep_for(kSlowTime);
+
+            if (std::string(data.begin(), data.end()) == kEchoRequest)
+            {
+                for (auto& payload : kFrames) client->Send(ToBytes(payload));
+            }
+        });
+
+    if (!started)
+    {
+        std::cout << "ERROR: server failed on start!\n";
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+
+    if (!TestServerPause(endpoint, server_peer, client_config))
+    {
+        std::cout << "ERROR: server paused from its callback did not hold the frames back!\n";
+        ok = false;
+    }
+    server_peer.SetPauseOnData(false);
+
+    if (!TestServerPauseLeaving(endpoint, server_peer, client_config))
+    {
+        std::cout << "ERROR: frames of clients gone while paused were not released!\n";
+        ok = false;
+    }
+    server_peer.SetPauseOnData(false);
+
+    if (!TestClientPause(endpoint, client_config))
+    {
+        std::cout << "ERROR: client paused from its callback did not hold the frames back!\n";
+        ok = false;
+    }
+    if (!TestServerWatermarks(endpoint, server_peer, client_config))
+    {
+        std::cout << "ERROR: server send watermarks were not reported!\n";
+        ok = false;
+    }
+    if (!TestClientWatermarks(endpoint, server_peer, client_config))
+    {
+        std::cout << "ERROR: client send watermarks were not reported!\n";
+        ok = false;
+    }
+
+    server->Stop();
+
+    if (!ok) return EXIT_FAILURE;
+
+    std::cout << "Successfull pause and resume!\n";
+
+    return EXIT_SUCCESS;
+}